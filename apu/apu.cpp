@@ -193,7 +193,7 @@
 #define APU_DENOMINATOR_PAL			709379
 #define APU_DEFAULT_RESAMPLER		HermiteResampler
 
-SNES_SPC	*spc_core = NULL;
+S9X_INSTANCE SNES_SPC	*spc_core = NULL;
 
 static uint8 APUROM[64] =
 {
@@ -209,30 +209,31 @@ static uint8 APUROM[64] =
 
 namespace spc
 {
-	static apu_callback	sa_callback     = NULL;
-	static void			*extra_data     = NULL;
+	static S9X_INSTANCE apu_callback	sa_callback     = NULL;
+	static S9X_INSTANCE void			*extra_data     = NULL;
 
-	static bool8		sound_in_sync   = TRUE;
-	static bool8		sound_enabled   = FALSE;
+	static S9X_INSTANCE bool8		sound_in_sync   = TRUE;
+	static S9X_INSTANCE bool8		sound_enabled   = FALSE;
 
-	static int			buffer_size;
-	static int			lag_master      = 0;
-	static int			lag             = 0;
+	static S9X_INSTANCE int			buffer_size;
+	static S9X_INSTANCE int			lag_master      = 0;
+	static S9X_INSTANCE int			lag             = 0;
 
-	static uint8		*landing_buffer = NULL;
-	static uint8		*shrink_buffer  = NULL;
+	static S9X_INSTANCE uint8		*landing_buffer = NULL;
+	static S9X_INSTANCE uint8		*shrink_buffer  = NULL;
+	static S9X_INSTANCE int			shrink_buffer_size = -1;
 
-	static Resampler	*resampler      = NULL;
+	static S9X_INSTANCE Resampler	*resampler      = NULL;
 
-	static int32		reference_time;
-	static uint32		remainder;
+	static S9X_INSTANCE int32		reference_time;
+	static S9X_INSTANCE uint32		remainder;
 
 	static const int	timing_hack_numerator   = SNES_SPC::tempo_unit;
-	static int			timing_hack_denominator = SNES_SPC::tempo_unit;
+	static S9X_INSTANCE int			timing_hack_denominator = SNES_SPC::tempo_unit;
 	/* Set these to NTSC for now. Will change to PAL in S9xAPUTimingSetSpeedup
 	   if necessary on game load. */
-	static uint32		ratio_numerator = APU_NUMERATOR_NTSC;
-	static uint32		ratio_denominator = APU_DENOMINATOR_NTSC;
+	static S9X_INSTANCE uint32		ratio_numerator = APU_NUMERATOR_NTSC;
+	static S9X_INSTANCE uint32		ratio_denominator = APU_DENOMINATOR_NTSC;
 }
 
 static void EightBitize (uint8 *, int);
@@ -282,7 +283,6 @@ static void ReverseStereo (uint8 *src_buffer, int sample_count)
 
 bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 {
-	static int	shrink_buffer_size = -1;
 	uint8		*dest;
 
 	if (!Settings.SixteenBitSound || !Settings.Stereo)
@@ -292,11 +292,11 @@ bool8 S9xMixSamples (uint8 *buffer, int sample_count)
 			sample_count <<= 1;
 
 		/* We still have to generate 16-bit samples for bit-dropping, too */
-		if (shrink_buffer_size < (sample_count << 1))
+		if (spc::shrink_buffer_size < (sample_count << 1))
 		{
 			delete[] spc::shrink_buffer;
 			spc::shrink_buffer = new uint8[sample_count << 1];
-			shrink_buffer_size = sample_count << 1;
+			spc::shrink_buffer_size = sample_count << 1;
 		}
 
 		dest = spc::shrink_buffer;
@@ -507,6 +507,7 @@ bool8 S9xInitAPU (void)
 
 	spc::landing_buffer = NULL;
 	spc::shrink_buffer  = NULL;
+	spc::shrink_buffer_size = -1;
 	spc::resampler      = NULL;
 
 	return (TRUE);
@@ -536,6 +537,7 @@ void S9xDeinitAPU (void)
 	{
 		delete[] spc::shrink_buffer;
 		spc::shrink_buffer = NULL;
+		spc::shrink_buffer_size = -1;
 	}
 }
 
@@ -580,6 +582,13 @@ void S9xAPUEndScanline (void)
 {
 	S9xAPUExecute();
 
+	if (Settings.Headless)
+	{
+		// The DSP still runs, its output is simply thrown away.
+		spc_core->set_output((SNES_SPC::sample_t *) spc::landing_buffer, spc::buffer_size >> 1);
+		return;
+	}
+
 	if (spc_core->sample_count() >= APU_MINIMUM_SAMPLE_BLOCK || !spc::sound_in_sync)
 		S9xLandSamples();
 }
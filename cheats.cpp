@@ -151,100 +151,60 @@ void S9xStartCheatSearch (SCheatData *d)
 	memset((char *) d->ALL_BITS, 0xff, 0x32000 >> 3);
 }
 
-void S9xSearchForChange (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, bool8 update)
+// Narrows one memory region's candidate bitmap against either a previous
+// copy (ref) or a value. Candidates are visited a 32-bit word at a time so
+// that already eliminated ranges cost nothing, and words of an 8-bit
+// (in)equality search whose 32 bytes are unchanged are settled with one
+// memcmp. Surviving bytes are copied to saved when updating.
+static void S9xSearchRegion (uint32 *bits, const uint8 *cur, const uint8 *ref, uint8 *saved, int len, int l, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, uint32 value, bool8 update)
 {
-	int	l, i;
+	int	end = len - l;
 
-	switch (size)
+	for (int w = 0; w < (end + 31) >> 5; w++)
 	{
-		case S9X_8_BITS:	l = 0; break;
-		case S9X_16_BITS:	l = 1; break;
-		case S9X_24_BITS:	l = 2; break;
-		default:
-		case S9X_32_BITS:	l = 3; break;
-	}
+		uint32	word = bits[w];
+		int		base = w << 5;
 
-	if (is_signed)
-	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->RAM, i), _S9XCHTDS(size, d->CWRAM, i)))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
+		if (!word)
+			continue;
 
-		for (i = 0; i < 0x10000 - l; i++)
+		if (ref && ref == saved && size == S9X_8_BITS && (cmp == S9X_EQUAL || cmp == S9X_NOT_EQUAL) &&
+			base + 32 <= end && !memcmp(cur + base, ref + base, 32))
 		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->SRAM, i), _S9XCHTDS(size, d->CSRAM, i)))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
+			if (cmp == S9X_NOT_EQUAL)
+				bits[w] = 0;
+			continue;
 		}
 
-		for (i = 0; i < 0x2000 - l; i++)
+		for (int j = 0; j < 32 && base + j < end; j++)
 		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->FillRAM + 0x3000, i), _S9XCHTDS(size, d->CIRAM, i)))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
-	}
-	else
-	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->RAM, i), _S9XCHTD(size, d->CWRAM, i)))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
+			int		i = base + j;
+			bool8	keep;
 
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->SRAM, i), _S9XCHTD(size, d->CSRAM, i)))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
+			if (!(word & (1 << j)))
+				continue;
+
+			if (is_signed)
+				keep = _S9XCHTC(cmp, _S9XCHTDS(size, cur, i), ref ? _S9XCHTDS(size, ref, i) : (int32) value);
 			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
+				keep = _S9XCHTC(cmp, _S9XCHTD(size, cur, i), ref ? _S9XCHTD(size, ref, i) : value);
 
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->FillRAM + 0x3000, i), _S9XCHTD(size, d->CIRAM, i)))
+			if (keep)
 			{
 				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
+					saved[i] = cur[i];
 			}
 			else
-				BIT_CLEAR(d->IRAM_BITS, i);
+				word &= ~(1 << j);
 		}
-	}
-
-	for (i = 0x20000 - l; i < 0x20000; i++)
-		BIT_CLEAR(d->WRAM_BITS, i);
 
-	for (i = 0x10000 - l; i < 0x10000; i++)
-		BIT_CLEAR(d->SRAM_BITS, i);
+		bits[w] = word;
+	}
 }
 
-void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 is_signed, bool8 update)
+static void S9xSearch (SCheatData *d, const uint8 *wram, const uint8 *sram, const uint8 *iram, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 is_signed, bool8 update)
 {
-	int l, i;
+	int	l, i;
 
 	switch (size)
 	{
@@ -255,76 +215,9 @@ void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataS
 		case S9X_32_BITS:	l = 3; break;
 	}
 
-	if (is_signed)
-	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->RAM, i), (int32) value))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->SRAM, i), (int32) value))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTDS(size, d->FillRAM + 0x3000, i), (int32) value))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
-	}
-	else
-	{
-		for (i = 0; i < 0x20000 - l; i++)
-		{
-			if (TEST_BIT(d->WRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->RAM, i), value))
-			{
-				if (update)
-					d->CWRAM[i] = d->RAM[i];
-			}
-			else
-				BIT_CLEAR(d->WRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x10000 - l; i++)
-		{
-			if (TEST_BIT(d->SRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->SRAM, i), value))
-			{
-				if (update)
-					d->CSRAM[i] = d->SRAM[i];
-			}
-			else
-				BIT_CLEAR(d->SRAM_BITS, i);
-		}
-
-		for (i = 0; i < 0x2000 - l; i++)
-		{
-			if (TEST_BIT(d->IRAM_BITS, i) && _S9XCHTC(cmp, _S9XCHTD(size, d->FillRAM + 0x3000, i), value))
-			{
-				if (update)
-					d->CIRAM[i] = d->FillRAM[i + 0x3000];
-			}
-			else
-				BIT_CLEAR(d->IRAM_BITS, i);
-		}
-	}
+	S9xSearchRegion(d->WRAM_BITS, d->RAM, wram, d->CWRAM, 0x20000, l, cmp, size, is_signed, value, update);
+	S9xSearchRegion(d->SRAM_BITS, d->SRAM, sram, d->CSRAM, 0x10000, l, cmp, size, is_signed, value, update);
+	S9xSearchRegion(d->IRAM_BITS, d->FillRAM + 0x3000, iram, d->CIRAM, 0x2000, l, cmp, size, is_signed, value, update);
 
 	for (i = 0x20000 - l; i < 0x20000; i++)
 		BIT_CLEAR(d->WRAM_BITS, i);
@@ -333,6 +226,16 @@ void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataS
 		BIT_CLEAR(d->SRAM_BITS, i);
 }
 
+void S9xSearchForChange (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, bool8 is_signed, bool8 update)
+{
+	S9xSearch(d, d->CWRAM, d->CSRAM, d->CIRAM, cmp, size, 0, is_signed, update);
+}
+
+void S9xSearchForValue (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 is_signed, bool8 update)
+{
+	S9xSearch(d, NULL, NULL, NULL, cmp, size, value, is_signed, update);
+}
+
 void S9xSearchForAddress (SCheatData *d, S9xCheatComparisonType cmp, S9xCheatDataSize size, uint32 value, bool8 update)
 {
 	int	l, i;
@@ -21,6 +21,13 @@ struct SCheat
 	bool8	enabled;
 };
 
+struct SCheatPatch
+{
+	struct SCheat	*c;
+	uint8	*map;		// Memory.Map entry the patch was resolved against
+	uint8	*host;		// direct pointer to the patched byte, NULL if mapped to hardware
+};
+
 struct SCheatGroup
 {
 	char *name;
@@ -31,6 +38,8 @@ struct SCheatGroup
 struct SCheatData
 {
 	std::vector<struct SCheatGroup> g;
+	std::vector<struct SCheatPatch> patches;
+	bool8	patches_valid;
 	bool8	enabled;
 	uint8	CWRAM[0x20000];
 	uint8	CSRAM[0x10000];
@@ -70,8 +79,8 @@ typedef enum
 	S9X_32_BITS
 }	S9xCheatDataSize;
 
-extern SCheatData	Cheat;
-extern Watch		watches[16];
+extern S9X_INSTANCE SCheatData	Cheat;
+extern S9X_INSTANCE Watch		watches[16];
 
 int S9xAddCheatGroup (const char *name, const char *cheat);
 int S9xModifyCheatGroup (uint32 index, const char *name, const char *cheat);
@@ -69,6 +69,10 @@ static inline uint8 S9xGetByteFree (uint32 Address)
         byte = *(Memory.BWRAM + ((Address & 0x7fff) - 0x6000));
         return (byte);
 
+    case CMemory::MAP_SA1_SHARED:
+        byte = *(SA1.SharedMap[block] + (Address & 0xffff));
+        return (byte);
+
     case CMemory::MAP_DSP:
         byte = S9xGetDSP(Address & 0xffff);
         return (byte);
@@ -167,6 +171,10 @@ static inline void S9xSetByteFree (uint8 Byte, uint32 Address)
         *(Memory.SRAM + (Address & 0xffff)) = Byte;
         return;
 
+    case CMemory::MAP_SA1_SHARED:
+        *(SA1.SharedMap[block] + (Address & 0xffff)) = Byte;
+        return;
+
     case CMemory::MAP_DSP:
         S9xSetDSP(Byte, Address & 0xffff);
         return;
@@ -211,14 +219,12 @@ void S9xInitCheatData (void)
 }
 
 
-void S9xUpdateCheatInMemory (SCheat *c)
+/* host is the resolved byte for a compiled patch, or NULL to go through the memory map */
+static inline void S9xApplyCheat (SCheat *c, uint8 *host)
 {
     uint8 byte;
 
-    if (!c->enabled)
-        return;
-
-    byte = S9xGetByteFree (c->address);
+    byte = host ? *host : S9xGetByteFree (c->address);
 
     if (byte != c->byte)
     {
@@ -235,9 +241,14 @@ void S9xUpdateCheatInMemory (SCheat *c)
             else if (c->saved_byte == c->cond_byte && !c->cond_true)
             {
                 c->cond_true = true;
-                S9xSetByteFree (c->byte, c->address);
+                if (host)
+                    *host = c->byte;
+                else
+                    S9xSetByteFree (c->byte, c->address);
             }
         }
+        else if (host)
+            *host = c->byte;
         else
             S9xSetByteFree (c->byte, c->address);
     }
@@ -247,9 +258,61 @@ void S9xUpdateCheatInMemory (SCheat *c)
         {
             c->cond_true = true;
             c->saved_byte = byte;
-            S9xSetByteFree (c->byte, c->address);
+            if (host)
+                *host = c->byte;
+            else
+                S9xSetByteFree (c->byte, c->address);
+        }
+    }
+}
+
+void S9xUpdateCheatInMemory (SCheat *c)
+{
+    if (!c->enabled)
+        return;
+
+    S9xApplyCheat (c, NULL);
+}
+
+static void S9xResolveCheatPatch (SCheatPatch *p)
+{
+    uint32 block = (p->c->address & 0xffffff) >> MEMMAP_SHIFT;
+
+    p->map = Memory.Map[block];
+
+    if (p->map >= (uint8 *) CMemory::MAP_LAST)
+        p->host = p->map + (p->c->address & 0xffff);
+    else if ((pint) p->map == CMemory::MAP_SA1_SHARED)
+        p->host = SA1.SharedMap[block] + (p->c->address & 0xffff);
+    else
+        p->host = NULL;
+}
+
+/* Flatten the enabled cheats into Cheat.patches, so the per-frame update
+   doesn't walk the groups or dispatch on the memory map for plain RAM/ROM. */
+static void S9xCompileCheats (void)
+{
+    unsigned int i;
+    unsigned int j;
+
+    Cheat.patches.clear ();
+
+    for (i = 0; i < Cheat.g.size (); i++)
+    {
+        for (j = 0; j < Cheat.g[i].c.size (); j++)
+        {
+            if (Cheat.g[i].c[j].enabled)
+            {
+                SCheatPatch p;
+
+                p.c = &Cheat.g[i].c[j];
+                S9xResolveCheatPatch (&p);
+                Cheat.patches.push_back (p);
+            }
         }
     }
+
+    Cheat.patches_valid = true;
 }
 
 void S9xDisableCheat (SCheat *c)
@@ -260,12 +323,14 @@ void S9xDisableCheat (SCheat *c)
     if (!Cheat.enabled)
     {
         c->enabled = false;
+        Cheat.patches_valid = false;
         return;
     }
 
     /* Make sure we restore the up-to-date written byte */
     S9xUpdateCheatInMemory (c);
     c->enabled = false;
+    Cheat.patches_valid = false;
 
     if (c->conditional && !c->cond_true)
         return;
@@ -289,6 +354,7 @@ void S9xDeleteCheatGroup (uint32 g)
     delete[] Cheat.g[g].name;
 
     Cheat.g.erase (Cheat.g.begin () + g);
+    Cheat.patches_valid = false;
 }
 
 void S9xDeleteCheats (void)
@@ -303,6 +369,7 @@ void S9xDeleteCheats (void)
     }
 
     Cheat.g.clear ();
+    Cheat.patches_valid = false;
 }
 
 void S9xEnableCheat (SCheat *c)
@@ -313,6 +380,7 @@ void S9xEnableCheat (SCheat *c)
         return;
 
     c->enabled = true;
+    Cheat.patches_valid = false;
 
     if (!Cheat.enabled)
         return;
@@ -438,6 +506,7 @@ int S9xAddCheatGroup (const char *name, const char *cheat)
         return -1;
 
     Cheat.g.push_back (g);
+    Cheat.patches_valid = false;
 
     return Cheat.g.size () - 1;
 }
@@ -451,6 +520,7 @@ int S9xModifyCheatGroup (uint32 num, const char *name, const char *cheat)
     delete[] Cheat.g[num].name;
 
     Cheat.g[num] = S9xCreateCheatGroup (name, cheat);
+    Cheat.patches_valid = false;
 
     return num;
 }
@@ -518,17 +588,23 @@ char *S9xCheatGroupToText (uint32 num)
 void S9xUpdateCheatsInMemory (void)
 {
     unsigned int i;
-    unsigned int j;
 
     if (!Cheat.enabled)
         return;
 
-    for (i = 0; i < Cheat.g.size (); i++)
+    if (!Cheat.patches_valid)
+        S9xCompileCheats ();
+
+    for (i = 0; i < Cheat.patches.size (); i++)
     {
-        for (j = 0; j < Cheat.g[i].c.size (); j++)
-        {
-            S9xUpdateCheatInMemory (&Cheat.g[i].c[j]);
-        }
+        SCheatPatch *p = &Cheat.patches[i];
+        uint8 *map = Memory.Map[(p->c->address & 0xffffff) >> MEMMAP_SHIFT];
+
+        /* The block was remapped since the patch was resolved (bank switch) */
+        if (map != p->map || (pint) map == CMemory::MAP_SA1_SHARED)
+            S9xResolveCheatPatch (p);
+
+        S9xApplyCheat (p->c, p->host);
     }
 }
 
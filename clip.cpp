@@ -16,8 +16,23 @@ static uint8	region_map[6][6] =
 	{ 0,    0,    0,    0,    0, 0x10 }
 };
 
+// HDMA window effects (spotlights, wavy borders, iris wipes) tend to cycle
+// through the same few window settings, so the computed regions are kept in a
+// small direct-mapped cache keyed by everything S9xComputeClipWindows reads.
+#define CLIP_CACHE_SIZE	32
+
+struct ClipCacheEntry
+{
+	uint32			Key[4];
+	bool8			Valid;
+	struct ClipData	Clip[2][6];
+};
+
+static S9X_INSTANCE struct ClipCacheEntry	ClipCache[CLIP_CACHE_SIZE];
+
 static inline uint8 CalcWindowMask (int, uint8, uint8);
 static inline void StoreWindowRegions (uint8, struct ClipData *, int, int16 *, uint8 *, bool8, bool8 s = FALSE);
+static void ComputeClipWindows (void);
 
 
 static inline uint8 CalcWindowMask (int i, uint8 W1, uint8 W2)
@@ -99,7 +114,55 @@ static inline void StoreWindowRegions (uint8 Mask, struct ClipData *Clip, int n_
 	Clip->Count = ct;
 }
 
+static inline void MakeClipCacheKey (uint32 *Key)
+{
+	uint8	b[16];
+
+	b[0] = PPU.Window1Left;
+	b[1] = PPU.Window1Right;
+	b[2] = PPU.Window2Left;
+	b[3] = PPU.Window2Right;
+
+	for (int i = 0; i < 6; i++)
+		b[4 + i] = (PPU.ClipWindow1Enable[i] ? 0x01 : 0) | (PPU.ClipWindow2Enable[i] ? 0x02 : 0) |
+				   (PPU.ClipWindow1Inside[i] ? 0x04 : 0) | (PPU.ClipWindow2Inside[i] ? 0x08 : 0) |
+				   (PPU.ClipWindowOverlapLogic[i] << 4);
+
+	b[10] = Memory.FillRAM[0x212e];
+	b[11] = Memory.FillRAM[0x212f];
+	b[12] = Memory.FillRAM[0x2130] & 0xf0;
+	b[13] = Settings.DisableGraphicWindows;
+	b[14] = b[15] = 0;
+
+	memcpy(Key, b, sizeof(b));
+}
+
 void S9xComputeClipWindows (void)
+{
+	uint32	Key[4];
+
+	MakeClipCacheKey(Key);
+
+	uint32	hash = Key[0] ^ (Key[1] * 31) ^ (Key[2] * 131) ^ Key[3];
+	hash ^= hash >> 16;
+	hash ^= hash >> 8;
+
+	struct ClipCacheEntry	*e = &ClipCache[hash & (CLIP_CACHE_SIZE - 1)];
+
+	if (e->Valid && !memcmp(e->Key, Key, sizeof(Key)))
+	{
+		memcpy(IPPU.Clip, e->Clip, sizeof(IPPU.Clip));
+		return;
+	}
+
+	ComputeClipWindows();
+
+	memcpy(e->Key, Key, sizeof(Key));
+	memcpy(e->Clip, IPPU.Clip, sizeof(IPPU.Clip));
+	e->Valid = TRUE;
+}
+
+static void ComputeClipWindows (void)
 {
 	int16	windows[6] = { 0, 256, 256, 256, 256, 256 };
 	uint8	drawing_modes[5] = { 0, 0, 0, 0, 0 };
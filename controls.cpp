@@ -20,6 +20,7 @@
 #include "crosshairs.h"
 #include "movie.h"
 #include "display.h"
+#include "screenshot.h"
 #ifdef NETPLAY_SUPPORT
 #include "netplay.h"
 #endif
@@ -68,8 +69,8 @@ using namespace	std;
 #define FLAG_IOBIT1				(Memory.FillRAM[0x4213] & 0x80)
 #define FLAG_IOBIT(n)			((n) ? (FLAG_IOBIT1) : (FLAG_IOBIT0))
 
-bool8	pad_read = 0, pad_read_last = 0;
-uint8	read_idx[2 /* ports */][2 /* per port */];
+S9X_INSTANCE bool8	pad_read = 0, pad_read_last = 0;
+S9X_INSTANCE uint8	read_idx[2 /* ports */][2 /* per port */];
 
 struct exemulti
 {
@@ -85,7 +86,7 @@ struct crosshair
 	uint8				fg, bg;
 };
 
-static struct
+static S9X_INSTANCE struct
 {
 	int16				x, y;
 	int16				V_adj;
@@ -95,7 +96,7 @@ static struct
 	bool8				mapped;
 }	pseudopointer[8];
 
-static struct
+static S9X_INSTANCE struct
 {
 	uint16				buttons;
 	uint16				turbos;
@@ -104,7 +105,7 @@ static struct
 	uint8				turbo_ct;
 }	joypad[8];
 
-static struct
+static S9X_INSTANCE struct
 {
 	uint8				delta_x, delta_y;
 	int16				old_x, old_y;
@@ -114,7 +115,7 @@ static struct
 	struct crosshair	crosshair;
 }	mouse[2];
 
-static struct
+static S9X_INSTANCE struct
 {
 	int16				x, y;
 	uint8				phys_buttons;
@@ -124,7 +125,7 @@ static struct
 	struct crosshair	crosshair;
 }	superscope;
 
-static struct
+static S9X_INSTANCE struct
 {
 	int16				x[2], y[2];
 	uint8				buttons;
@@ -133,12 +134,12 @@ static struct
 	struct crosshair	crosshair[2];
 }	justifier;
 
-static struct
+static S9X_INSTANCE struct
 {
 	int8				pads[4];
 }	mp5[2];
 
-static struct
+static S9X_INSTANCE struct
 {
 	int16				x, y;
 	uint8				buttons;
@@ -146,16 +147,16 @@ static struct
 	struct crosshair	crosshair;
 }	macsrifle;
 
-static set<struct exemulti *>		exemultis;
-static set<uint32>					pollmap[NUMCTLS + 1];
-static map<uint32, s9xcommand_t>	keymap;
-static vector<s9xcommand_t *>		multis;
-static uint8						turbo_time;
-static uint8						pseudobuttons[256];
-static bool8						FLAG_LATCH = FALSE;
-static int32						curcontrollers[2] = { NONE,    NONE };
-static int32						newcontrollers[2] = { JOYPAD0, NONE };
-static char							buf[256];
+static S9X_INSTANCE set<struct exemulti *>		exemultis;
+static S9X_INSTANCE set<uint32>					pollmap[NUMCTLS + 1];
+static S9X_INSTANCE map<uint32, s9xcommand_t>	keymap;
+static S9X_INSTANCE vector<s9xcommand_t *>		multis;
+static S9X_INSTANCE uint8						turbo_time;
+static S9X_INSTANCE uint8						pseudobuttons[256];
+static S9X_INSTANCE bool8						FLAG_LATCH = FALSE;
+static S9X_INSTANCE int32						curcontrollers[2] = { NONE,    NONE };
+static S9X_INSTANCE int32						newcontrollers[2] = { JOYPAD0, NONE };
+static S9X_INSTANCE char							buf[256];
 
 static const char	*color_names[32] =
 {
@@ -249,6 +250,7 @@ static const int	ptrspeeds[4] = { 1, 1, 4, 8 };
 	S(SaveFreezeFile), \
 	S(SaveSPC), \
 	S(Screenshot), \
+	S(ScreenshotBurst), \
 	S(SeekToFrame), \
 	S(SoftReset), \
 	S(SoundChannel0), \
@@ -786,7 +788,7 @@ void S9xGetController (int port, enum controllers *controller, int8 *id1, int8 *
 
 void S9xReportControllers (void)
 {
-	static char	mes[128];
+	static S9X_INSTANCE char	mes[128];
 	char		*c = mes;
 
 	S9xVerifyControllers();
@@ -2365,6 +2367,10 @@ void S9xApplyCommand (s9xcommand_t cmd, int16 data1, int16 data2)
 						Settings.TakeScreenshot = TRUE;
 						break;
 
+					case ScreenshotBurst:
+						S9xScreenshotBurst(SCREENSHOT_BURST_FRAMES);
+						break;
+
 					case SoundChannel0:
 					case SoundChannel1:
 					case SoundChannel2:
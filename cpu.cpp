@@ -14,6 +14,7 @@
 #include "snapshot.h"
 #include "cheats.h"
 #include "logger.h"
+#include "statehash.h"
 #ifdef DEBUGGER
 #include "debug.h"
 #endif
@@ -48,6 +49,7 @@ static void S9xSoftResetCPU (void)
 	CPU.MemSpeed = SLOW_ONE_CYCLE;
 	CPU.MemSpeedx2 = SLOW_ONE_CYCLE * 2;
 	CPU.FastROMSpeed = SLOW_ONE_CYCLE;
+	Memory.UpdateSpeedMap();
 	CPU.InDMA = FALSE;
 	CPU.InHDMA = FALSE;
 	CPU.InDMAorHDMA = FALSE;
@@ -100,6 +102,7 @@ void S9xReset (void)
 {
 	S9xResetSaveTimer(FALSE);
 	S9xResetLogger();
+	S9xResetStateHash();
 
 	memset(Memory.RAM, 0x55, 0x20000);
 	memset(Memory.VRAM, 0x00, 0x10000);
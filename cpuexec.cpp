@@ -135,6 +135,7 @@ void S9xMainLoop (void)
 			#ifdef DEBUGGER
 			if (!(CPU.Flags & FRAME_ADVANCE_FLAG))
 			#endif
+			if (!Settings.Headless)
 			{
 				S9xSyncSpeed();
 			}
@@ -158,7 +159,10 @@ void S9xMainLoop (void)
 			Opcodes = S9xOpcodesSlow;
 		}
 
-		if ((Registers.PCw & MEMMAP_MASK) + ICPU.S9xOpLengths[Op] >= MEMMAP_BLOCK_SIZE)
+		// Only instructions in the last few bytes of a block can cross it,
+		// so skip the length lookup everywhere else.
+		if ((Registers.PCw & MEMMAP_MASK) >= MEMMAP_BLOCK_SIZE - MAX_OPCODE_LENGTH &&
+			(Registers.PCw & MEMMAP_MASK) + ICPU.S9xOpLengths[Op] >= MEMMAP_BLOCK_SIZE)
 		{
 			uint8	*oldPCBase = CPU.PCBase;
 
@@ -170,11 +174,33 @@ void S9xMainLoop (void)
 		Registers.PCw++;
 		(*Opcodes[Op].S9xOpcode)();
 
-		if (Settings.SA1)
+		if (Settings.SA1 && (!Settings.SA1SyncQuantum || CPU.Cycles * 3 - SA1.Cycles >= Settings.SA1SyncQuantum * 3))
 			S9xSA1MainLoop();
 	}
 
+	S9xSA1Sync();
 	S9xPackStatus();
+
+	S9xMovieKeyframe();
+}
+
+// Emulates frames as fast as possible, e.g. to resimulate after a state load.
+// Nothing is drawn, no samples reach the sound buffer and the frontend is not
+// asked to sync or present, but PPU and APU state advance exactly as usual.
+void S9xRunFramesHeadless (uint32 frames)
+{
+	bool8	render = IPPU.RenderThisFrame, headless = Settings.Headless;
+
+	Settings.Headless = TRUE;
+
+	while (frames--)
+	{
+		IPPU.RenderThisFrame = FALSE;
+		S9xMainLoop();
+	}
+
+	Settings.Headless = headless;
+	IPPU.RenderThisFrame = render;
 }
 
 static inline void S9xReschedule (void)
@@ -12,6 +12,9 @@
 #include "debug.h"
 #endif
 
+// Longest 65c816 instruction in bytes, see S9xOpLengths.
+#define MAX_OPCODE_LENGTH	4
+
 struct SOpcodes
 {
 	void (*S9xOpcode) (void);
@@ -31,7 +34,7 @@ struct SICPU
 	uint32	FrameAdvanceCount;
 };
 
-extern struct SICPU		ICPU;
+extern S9X_INSTANCE struct SICPU		ICPU;
 
 extern struct SOpcodes	S9xOpcodesE1[256];
 extern struct SOpcodes	S9xOpcodesM1X1[256];
@@ -45,6 +48,7 @@ extern uint8			S9xOpLengthsM0X1[256];
 extern uint8			S9xOpLengthsM0X0[256];
 
 void S9xMainLoop (void);
+void S9xRunFramesHeadless (uint32);
 void S9xReset (void);
 void S9xSoftReset (void);
 void S9xDoHEventProcessing (void);
@@ -18,7 +18,7 @@
 
 #include "apu/bapu/snes/snes.hpp"
 
-extern SDMA	DMA[8];
+extern S9X_INSTANCE SDMA	DMA[8];
 extern FILE	*apu_trace;
 FILE		*trace = NULL, *trace2 = NULL;
 
@@ -195,6 +195,10 @@ static uint8 S9xDebugGetByte (uint32 Address)
 			byte = *(Memory.BWRAM + ((Address & 0x7fff) - 0x6000));
 			return (byte);
 
+		case CMemory::MAP_SA1_SHARED:
+			byte = *(SA1.SharedMap[block] + (Address & 0xffff));
+			return (byte);
+
 		default:
 			return (byte);
 	}
@@ -16,11 +16,11 @@
 
 #define ADD_CYCLES(n)	{ CPU.Cycles += (n); }
 
-extern uint8	*HDMAMemPointers[8];
+extern S9X_INSTANCE uint8	*HDMAMemPointers[8];
 extern int		HDMA_ModeByteCounts[8];
-extern SPC7110	s7emu;
+extern S9X_INSTANCE SPC7110	s7emu;
 
-static uint8	sdd1_decode_buffer[0x10000];
+static S9X_INSTANCE uint8	sdd1_decode_buffer[0x10000];
 
 static inline bool8 addCyclesInDMA (uint8);
 static inline bool8 HDMAReadLineCount (int);
@@ -51,6 +51,8 @@ static inline bool8 addCyclesInDMA (uint8 dma_channel)
 
 bool8 S9xDoDMA (uint8 Channel)
 {
+	S9xSA1Sync();
+
 	CPU.InDMA = TRUE;
     CPU.InDMAorHDMA = TRUE;
 	CPU.CurrentDMAorHDMAChannel = Channel;
@@ -1244,6 +1246,8 @@ uint8 S9xDoHDMA (uint8 byte)
 	int	d;
 	uint8	mask;
 
+	S9xSA1Sync();
+
 	CPU.InHDMA = TRUE;
 	CPU.InDMAorHDMA = TRUE;
 	CPU.HDMARanInDMA = CPU.InDMA ? byte : 0;
@@ -32,22 +32,16 @@
 			S9xDoHEventProcessing(); \
 	}
 
-extern uint8	OpenBus;
+extern S9X_INSTANCE uint8	OpenBus;
 
 static inline int32 memory_speed (uint32 address)
 {
-	if (address & 0x408000)
-	{
-		if (address & 0x800000)
-			return (CPU.FastROMSpeed);
-
-		return (SLOW_ONE_CYCLE);
-	}
+	int32	speed = Memory.SpeedMap[(address & 0xffffff) >> MEMMAP_SHIFT];
 
-	if ((address + 0x6000) & 0x4000)
-		return (SLOW_ONE_CYCLE);
+	if (speed)
+		return (speed);
 
-	if ((address - 0x4000) & 0x7e00)
+	if (address & 0x0e00)
 		return (ONE_CYCLE);
 
 	return (TWO_CYCLES);
@@ -104,10 +98,17 @@ inline uint8 S9xGetByte (uint32 Address)
 			return (byte);
 
 		case CMemory::MAP_BWRAM:
+			S9xSA1Sync();
 			byte = *(Memory.BWRAM + ((Address & 0x7fff) - 0x6000));
 			addCyclesInMemoryAccess;
 			return (byte);
 
+		case CMemory::MAP_SA1_SHARED:
+			S9xSA1Sync();
+			byte = *(SA1.SharedMap[block] + (Address & 0xffff));
+			addCyclesInMemoryAccess;
+			return (byte);
+
 		case CMemory::MAP_DSP:
 			byte = S9xGetDSP(Address & 0xffff);
 			addCyclesInMemoryAccess;
@@ -248,10 +249,17 @@ inline uint16 S9xGetWord (uint32 Address, enum s9xwrap_t w = WRAP_NONE)
 			return (word);
 
 		case CMemory::MAP_BWRAM:
+			S9xSA1Sync();
 			word = READ_WORD(Memory.BWRAM + ((Address & 0x7fff) - 0x6000));
 			addCyclesInMemoryAccess_x2;
 			return (word);
 
+		case CMemory::MAP_SA1_SHARED:
+			S9xSA1Sync();
+			word = READ_WORD(SA1.SharedMap[block] + (Address & 0xffff));
+			addCyclesInMemoryAccess_x2;
+			return (word);
+
 		case CMemory::MAP_DSP:
 			word  = S9xGetDSP(Address & 0xffff);
 			addCyclesInMemoryAccess;
@@ -375,11 +383,18 @@ inline void S9xSetByte (uint8 Byte, uint32 Address)
 			return;
 
 		case CMemory::MAP_BWRAM:
+			S9xSA1Sync();
 			*(Memory.BWRAM + ((Address & 0x7fff) - 0x6000)) = Byte;
 			CPU.SRAMModified = TRUE;
 			addCyclesInMemoryAccess;
 			return;
 
+		case CMemory::MAP_SA1_SHARED:
+			S9xSA1Sync();
+			*(SA1.SharedMap[block] + (Address & 0xffff)) = Byte;
+			addCyclesInMemoryAccess;
+			return;
+
 		case CMemory::MAP_SA1RAM:
 			*(Memory.SRAM + (Address & 0xffff)) = Byte;
 			addCyclesInMemoryAccess;
@@ -568,11 +583,18 @@ inline void S9xSetWord (uint16 Word, uint32 Address, enum s9xwrap_t w = WRAP_NON
 			return;
 
 		case CMemory::MAP_BWRAM:
+			S9xSA1Sync();
 			WRITE_WORD(Memory.BWRAM + ((Address & 0x7fff) - 0x6000), Word);
 			CPU.SRAMModified = TRUE;
 			addCyclesInMemoryAccess_x2;
 			return;
 
+		case CMemory::MAP_SA1_SHARED:
+			S9xSA1Sync();
+			WRITE_WORD(SA1.SharedMap[block] + (Address & 0xffff), Word);
+			addCyclesInMemoryAccess_x2;
+			return;
+
 		case CMemory::MAP_SA1RAM:
 			WRITE_WORD(Memory.SRAM + (Address & 0xffff), Word);
 			addCyclesInMemoryAccess_x2;
@@ -740,6 +762,10 @@ inline void S9xSetPCBase (uint32 Address)
 			CPU.PCBase = Memory.SRAM;
 			return;
 
+		case CMemory::MAP_SA1_SHARED:
+			CPU.PCBase = SA1.SharedMap[(Address & 0xffffff) >> MEMMAP_SHIFT];
+			return;
+
 		case CMemory::MAP_SPC7110_ROM:
 			CPU.PCBase = S9xGetBasePointerSPC7110(Address);
 			return;
@@ -793,6 +819,9 @@ inline uint8 * S9xGetBasePointer (uint32 Address)
 		case CMemory::MAP_SA1RAM:
 			return (Memory.SRAM);
 
+		case CMemory::MAP_SA1_SHARED:
+			return (SA1.SharedMap[(Address & 0xffffff) >> MEMMAP_SHIFT]);
+
 		case CMemory::MAP_SPC7110_ROM:
 			return (S9xGetBasePointerSPC7110(Address));
 
@@ -838,6 +867,9 @@ inline uint8 * S9xGetMemPointer (uint32 Address)
 		case CMemory::MAP_SA1RAM:
 			return (Memory.SRAM + (Address & 0xffff));
 
+		case CMemory::MAP_SA1_SHARED:
+			return (SA1.SharedMap[(Address & 0xffffff) >> MEMMAP_SHIFT] + (Address & 0xffff));
+
 		case CMemory::MAP_SPC7110_ROM:
 			return (S9xGetBasePointerSPC7110(Address) + (Address & 0xffff));
 
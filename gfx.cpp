@@ -12,12 +12,13 @@
 #include "cheats.h"
 #include "movie.h"
 #include "screenshot.h"
+#include "statehash.h"
 #include "font.h"
 #include "display.h"
 
-extern struct SCheatData		Cheat;
-extern struct SLineData			LineData[240];
-extern struct SLineMatrixData	LineMatrixData[240];
+extern S9X_INSTANCE struct SCheatData		Cheat;
+extern S9X_INSTANCE struct SLineData			LineData[240];
+extern S9X_INSTANCE struct SLineMatrixData	LineMatrixData[240];
 
 void S9xComputeClipWindows (void);
 
@@ -37,7 +38,8 @@ static void DrawBackgroundOffset (int, uint8, uint8, int);
 static void DrawBackgroundOffsetMosaic (int, uint8, uint8, int);
 static inline void DrawBackgroundMode7 (int, void (*DrawMath) (uint32, uint32, int), void (*DrawNomath) (uint32, uint32, int), int);
 static inline void DrawBackdrop (void);
-static inline void RenderScreen (bool8);
+static inline void RenderScreen (bool8, struct ClipData *);
+static struct ClipData * SubScreenClips (void);
 static uint16 get_crosshair_color (uint8);
 static void S9xDisplayStringType (const char *, int, int, bool, int);
 
@@ -52,6 +54,7 @@ bool8 S9xGraphicsInit (void)
 	GFX.RealPPL = GFX.Pitch >> 1;
 	IPPU.OBJChanged = TRUE;
 	Settings.BG_Forced = 0;
+	S9xResetPaletteCache();
 	S9xFixColourBrightness();
 	S9xBuildDirectColourMaps();
 
@@ -153,13 +156,28 @@ void S9xGraphicsScreenResize (void)
 	}	
 }
 
+// Direct colour only depends on the brightness, so all 16 variants are built once.
+static S9X_INSTANCE uint16	DirectColourMapCache[16][8][256];
+static S9X_INSTANCE bool		DirectColourMapCacheBuilt = false;
+
 void S9xBuildDirectColourMaps (void)
 {
-	IPPU.XB = mul_brightness[PPU.Brightness];
+	if (!DirectColourMapCacheBuilt)
+	{
+		for (uint32 b = 0; b < 16; b++)
+		{
+			uint8	*XB = mul_brightness[b];
+
+			for (uint32 p = 0; p < 8; p++)
+				for (uint32 c = 0; c < 256; c++)
+					DirectColourMapCache[b][p][c] = BUILD_PIXEL(XB[((c & 7) << 2) | ((p & 1) << 1)], XB[((c & 0x38) >> 1) | (p & 2)], XB[((c & 0xc0) >> 3) | (p & 4)]);
+		}
+
+		DirectColourMapCacheBuilt = true;
+	}
 
-	for (uint32 p = 0; p < 8; p++)
-		for (uint32 c = 0; c < 256; c++)
-			DirectColourMaps[p][c] = BUILD_PIXEL(IPPU.XB[((c & 7) << 2) | ((p & 1) << 1)], IPPU.XB[((c & 0x38) >> 1) | (p & 2)], IPPU.XB[((c & 0xc0) >> 3) | (p & 4)]);
+	IPPU.XB = mul_brightness[PPU.Brightness];
+	DirectColourMaps = DirectColourMapCache[PPU.Brightness];
 }
 
 void S9xStartScreenRefresh (void)
@@ -191,6 +209,9 @@ void S9xStartScreenRefresh (void)
 		memset(GFX.SubZBuffer, 0, GFX.ScreenSize);
 	}
 
+	IPPU.SubScreenPixelsSkippedLast = IPPU.SubScreenPixelsSkipped;
+	IPPU.SubScreenPixelsSkipped = 0;
+
 	if (++IPPU.FrameCount % Memory.ROMFramesPerSecond == 0)
 	{
 		IPPU.DisplayedRenderedFrameCount = IPPU.RenderedFramesCount;
@@ -230,6 +251,9 @@ void S9xEndScreenRefresh (void)
 			if (Settings.TakeScreenshot)
 				S9xDoScreenshot(IPPU.RenderedScreenWidth, IPPU.RenderedScreenHeight);
 
+			if (Settings.StateHashMode)
+				S9xStateHashScreen(IPPU.RenderedScreenWidth, IPPU.RenderedScreenHeight);
+
 			if (Settings.AutoDisplayMessages)
 				S9xDisplayMessages(GFX.Screen, GFX.RealPPL, IPPU.RenderedScreenWidth, IPPU.RenderedScreenHeight, 1);
 
@@ -241,6 +265,9 @@ void S9xEndScreenRefresh (void)
 
 	S9xUpdateCheatsInMemory ();
 
+	if (Settings.StateHashMode)
+		S9xStateHashFrame();
+
 #ifdef DEBUGGER
 	if (CPU.Flags & FRAME_ADVANCE_FLAG)
 	{
@@ -311,13 +338,78 @@ void RenderLine (uint8 C)
 	{
 		// if we're not rendering this frame, we still need to update this
 		// XXX: Check ForceBlank? Or anything else?
-		if (IPPU.OBJChanged)
+		if (IPPU.OBJChanged || IPPU.OBJEntriesChanged)
 			SetupOBJ();
 		PPU.RangeTimeOver |= GFX.OBJLines[C].RTOFlags;
 	}
 }
 
-static inline void RenderScreen (bool8 sub)
+// Color math reads the subscreen only where the color window allows math, so
+// the subscreen clips are cut down to those spans. Returns NULL when math is
+// windowed out everywhere and the subscreen isn't needed at all.
+static struct ClipData * SubScreenClips (void)
+{
+	static S9X_INSTANCE struct ClipData	clips[6];
+	struct ClipData	*math = &IPPU.Clip[0][5];
+	uint16			left[6], right[6];
+	int				spans = 0, width = 0;
+
+	for (int i = 0; i < math->Count; i++)
+	{
+		if (!(math->DrawMode[i] & 2))
+			continue;
+
+		if (spans && right[spans - 1] == math->Left[i])
+			right[spans - 1] = math->Right[i];
+		else
+		{
+			left[spans]  = math->Left[i];
+			right[spans] = math->Right[i];
+			spans++;
+		}
+
+		width += math->Right[i] - math->Left[i];
+	}
+
+	IPPU.SubScreenPixelsSkipped += (256 - width) * (GFX.EndY - GFX.StartY + 1);
+
+	if (!spans)
+		return (NULL);
+
+	if (width == 256)
+		return (IPPU.Clip[1]);
+
+	// Both sets of regions come from the same window partition, so the
+	// intersection never has more pieces than a clip can hold.
+	for (int c = 0; c < 6; c++)
+	{
+		struct ClipData	*src = &IPPU.Clip[1][c], *dst = &clips[c];
+		int				ct = 0;
+
+		for (int i = 0; i < src->Count; i++)
+		{
+			for (int s = 0; s < spans && ct < 6; s++)
+			{
+				uint16	l = src->Left[i]  > left[s]  ? src->Left[i]  : left[s];
+				uint16	r = src->Right[i] < right[s] ? src->Right[i] : right[s];
+
+				if (l < r)
+				{
+					dst->Left[ct]     = l;
+					dst->Right[ct]    = r;
+					dst->DrawMode[ct] = src->DrawMode[i];
+					ct++;
+				}
+			}
+		}
+
+		dst->Count = ct;
+	}
+
+	return (clips);
+}
+
+static inline void RenderScreen (bool8 sub, struct ClipData *clip)
 {
 	uint8	BGActive;
 	int		D;
@@ -328,7 +420,7 @@ static inline void RenderScreen (bool8 sub)
 		if (GFX.DoInterlace && GFX.InterlaceFrame)
 			GFX.S += GFX.RealPPL;
 		GFX.DB = GFX.ZBuffer;
-		GFX.Clip = IPPU.Clip[0];
+		GFX.Clip = clip;
 		BGActive = Memory.FillRAM[0x212c] & ~Settings.BG_Forced;
 		D = 32;
 	}
@@ -336,7 +428,7 @@ static inline void RenderScreen (bool8 sub)
 	{
 		GFX.S = GFX.SubScreen;
 		GFX.DB = GFX.SubZBuffer;
-		GFX.Clip = IPPU.Clip[1];
+		GFX.Clip = clip;
 		BGActive = Memory.FillRAM[0x212d] & ~Settings.BG_Forced;
 		D = (Memory.FillRAM[0x2130] & 2) << 4; // 'do math' depth flag
 	}
@@ -447,7 +539,7 @@ static inline void RenderScreen (bool8 sub)
 
 void S9xUpdateScreen (void)
 {
-	if (IPPU.OBJChanged || IPPU.InterlaceOBJ)
+	if (IPPU.OBJChanged || IPPU.OBJEntriesChanged || IPPU.InterlaceOBJ)
 		SetupOBJ();
 
 	// XXX: Check ForceBlank? Or anything else?
@@ -522,13 +614,19 @@ void S9xUpdateScreen (void)
 		if ((Memory.FillRAM[0x2130] & 0x30) != 0x30 && (Memory.FillRAM[0x2131] & 0x3f))
 			GFX.FixedColour = BUILD_PIXEL(IPPU.XB[PPU.FixedColourRed], IPPU.XB[PPU.FixedColourGreen], IPPU.XB[PPU.FixedColourBlue]);
 
-		if (PPU.BGMode == 5 || PPU.BGMode == 6 || IPPU.PseudoHires ||
-			((Memory.FillRAM[0x2130] & 0x30) != 0x30 && (Memory.FillRAM[0x2130] & 2) && (Memory.FillRAM[0x2131] & 0x3f) && (Memory.FillRAM[0x212d] & 0x1f)))
-			// If hires (Mode 5/6 or pseudo-hires) or math is to be done
-			// involving the subscreen, then we need to render the subscreen...
-			RenderScreen(TRUE);
+		if (PPU.BGMode == 5 || PPU.BGMode == 6 || IPPU.PseudoHires)
+			// Hires (Mode 5/6 or pseudo-hires) shows the whole subscreen
+			RenderScreen(TRUE, IPPU.Clip[1]);
+		else
+		if ((Memory.FillRAM[0x2130] & 0x30) != 0x30 && (Memory.FillRAM[0x2130] & 2) && (Memory.FillRAM[0x2131] & 0x3f) && (Memory.FillRAM[0x212d] & 0x1f))
+		{
+			// Math involving the subscreen only needs it where math happens
+			struct ClipData	*clip = SubScreenClips();
+			if (clip)
+				RenderScreen(TRUE, clip);
+		}
 
-		RenderScreen(FALSE);
+		RenderScreen(FALSE, IPPU.Clip[0]);
 	}
 	else
 	{
@@ -546,6 +644,144 @@ void S9xUpdateScreen (void)
 	IPPU.PreviousLine = IPPU.CurrentLine;
 }
 
+// Per-line sprite membership kept between SetupOBJ calls, so that OAM writes
+// only cost the lines covered by the sprites they touch.
+static S9X_INSTANCE struct
+{
+	bool8	Valid;
+	int		SpriteLimit;
+	int		MaxTiles;
+	int		StartLine;
+	int		Inc;
+	uint8	VPos[128];
+	uint8	Rows[128];
+	uint8	RTOFlags[SNES_HEIGHT_EXTENDED];
+	uint32	Members[SNES_HEIGHT_EXTENDED][4];
+}	OBJIndex;
+
+static void SetupOBJGeometry (int S, int SmallWidth, int SmallHeight, int LargeWidth, int LargeHeight)
+{
+	int	Height;
+
+	if (PPU.OBJ[S].Size)
+	{
+		GFX.OBJWidths[S] = LargeWidth;
+		Height = LargeHeight;
+	}
+	else
+	{
+		GFX.OBJWidths[S] = SmallWidth;
+		Height = SmallHeight;
+	}
+
+	int	HPos = PPU.OBJ[S].HPos;
+	if (HPos == -256)
+		HPos = 0;
+
+	OBJIndex.VPos[S] = (uint8) (PPU.OBJ[S].VPos & 0xff);
+	OBJIndex.Rows[S] = 0;
+
+	if (HPos > -GFX.OBJWidths[S] && HPos <= 256)
+	{
+		if (HPos < 0)
+			GFX.OBJVisibleTiles[S] = (GFX.OBJWidths[S] + HPos + 7) >> 3;
+		else
+		if (HPos + GFX.OBJWidths[S] > 255)
+			GFX.OBJVisibleTiles[S] = (256 - HPos + 7) >> 3;
+		else
+			GFX.OBJVisibleTiles[S] = GFX.OBJWidths[S] >> 3;
+
+		OBJIndex.Rows[S] = (Height - OBJIndex.StartLine + OBJIndex.Inc - 1) / OBJIndex.Inc;
+	}
+}
+
+static void LinkOBJ (int S, bool8 *LineChanged)
+{
+	for (int r = 0; r < OBJIndex.Rows[S]; r++)
+	{
+		uint8	Y = OBJIndex.VPos[S] + r;
+
+		if (Y < SNES_HEIGHT_EXTENDED)
+		{
+			OBJIndex.Members[Y][S >> 5] |= 1 << (S & 31);
+			if (LineChanged)
+				LineChanged[Y] = TRUE;
+		}
+	}
+}
+
+static void UnlinkOBJ (int S, bool8 *LineChanged)
+{
+	for (int r = 0; r < OBJIndex.Rows[S]; r++)
+	{
+		uint8	Y = OBJIndex.VPos[S] + r;
+
+		if (Y < SNES_HEIGHT_EXTENDED)
+		{
+			OBJIndex.Members[Y][S >> 5] &= ~(1 << (S & 31));
+			LineChanged[Y] = TRUE;
+		}
+	}
+}
+
+static void BuildOBJLine (int Y)
+{
+	int		j = 0;
+	uint8	RTOFlags = 0;
+	int16	Tiles = OBJIndex.MaxTiles;
+
+	// Sprites are taken in priority order, starting with FirstSprite.
+	for (int pass = 0; pass < 2; pass++)
+	{
+		int	S   = pass ? 0 : PPU.FirstSprite;
+		int	End = pass ? PPU.FirstSprite : 128;
+
+		while (S < End)
+		{
+			uint32	bits = OBJIndex.Members[Y][S >> 5] >> (S & 31);
+
+			if (!bits)
+			{
+				S = (S | 31) + 1;
+				continue;
+			}
+
+			if (bits & 1)
+			{
+				if (j >= OBJIndex.SpriteLimit)
+				{
+					RTOFlags |= 0x40;
+					break;
+				}
+
+				Tiles -= GFX.OBJVisibleTiles[S];
+				if (Tiles < 0)
+					RTOFlags |= 0x80;
+
+				uint8	line = OBJIndex.StartLine + ((uint8) (Y - OBJIndex.VPos[S])) * OBJIndex.Inc;
+
+				GFX.OBJLines[Y].OBJ[j].Sprite = S;
+				if (PPU.OBJ[S].VFlip)
+					// Yes, Width not Height. It so happens that the
+					// sprites with H=2*W flip as two WxW sprites.
+					GFX.OBJLines[Y].OBJ[j].Line = line ^ (GFX.OBJWidths[S] - 1);
+				else
+					GFX.OBJLines[Y].OBJ[j].Line = line;
+
+				j++;
+			}
+
+			S++;
+		}
+	}
+
+	for (int k = j; k < OBJIndex.SpriteLimit; k++)
+		GFX.OBJLines[Y].OBJ[k].Sprite = -1;
+
+	GFX.OBJLines[Y].Tiles = Tiles;
+	OBJIndex.RTOFlags[Y] = RTOFlags;
+}
+
 static void SetupOBJ (void)
 {
 	int	SmallWidth, SmallHeight, LargeWidth, LargeHeight;
@@ -608,79 +844,61 @@ static void SetupOBJ (void)
 
 	if (!PPU.OAMPriorityRotation || !(PPU.OAMFlip & PPU.OAMAddr & 1)) // normal case
 	{
-		uint8	LineOBJ[SNES_HEIGHT_EXTENDED];
-		memset(LineOBJ, 0, sizeof(LineOBJ));
-
-		for (int i = 0; i < SNES_HEIGHT_EXTENDED; i++)
+		// Only the lines touched by sprites whose OAM entry changed need to be
+		// rebuilt, unless something affecting all sprites changed as well.
+		bool8	full = IPPU.OBJChanged || !OBJIndex.Valid ||
+					   OBJIndex.SpriteLimit != sprite_limit || OBJIndex.MaxTiles != Settings.MaxSpriteTilesPerLine ||
+					   OBJIndex.StartLine != startline || OBJIndex.Inc != inc;
+
+		OBJIndex.SpriteLimit = sprite_limit;
+		OBJIndex.MaxTiles = Settings.MaxSpriteTilesPerLine;
+		OBJIndex.StartLine = startline;
+		OBJIndex.Inc = inc;
+
+		if (full)
 		{
-			GFX.OBJLines[i].RTOFlags = 0;
-			GFX.OBJLines[i].Tiles = Settings.MaxSpriteTilesPerLine;
-			for (int j = 0; j < sprite_limit; j++)
-				GFX.OBJLines[i].OBJ[j].Sprite = -1;
-		}
+			memset(OBJIndex.Members, 0, sizeof(OBJIndex.Members));
 
-		uint8	FirstSprite = PPU.FirstSprite;
-		S = FirstSprite;
-
-		do
-		{
-			if (PPU.OBJ[S].Size)
-			{
-				GFX.OBJWidths[S] = LargeWidth;
-				Height = LargeHeight;
-			}
-			else
+			for (int i = 0; i < 128; i++)
 			{
-				GFX.OBJWidths[S] = SmallWidth;
-				Height = SmallHeight;
+				SetupOBJGeometry(i, SmallWidth, SmallHeight, LargeWidth, LargeHeight);
+				LinkOBJ(i, NULL);
 			}
 
-			int	HPos = PPU.OBJ[S].HPos;
-			if (HPos == -256)
-				HPos = 0;
+			for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+				BuildOBJLine(Y);
 
-			if (HPos > -GFX.OBJWidths[S] && HPos <= 256)
-			{
-				if (HPos < 0)
-					GFX.OBJVisibleTiles[S] = (GFX.OBJWidths[S] + HPos + 7) >> 3;
-				else
-				if (HPos + GFX.OBJWidths[S] > 255)
-					GFX.OBJVisibleTiles[S] = (256 - HPos + 7) >> 3;
-				else
-					GFX.OBJVisibleTiles[S] = GFX.OBJWidths[S] >> 3;
+			IPPU.OBJFullSetups++;
+		}
+		else
+		{
+			bool8	LineChanged[SNES_HEIGHT_EXTENDED];
+			memset(LineChanged, FALSE, sizeof(LineChanged));
 
-				for (uint8 line = startline, Y = (uint8) (PPU.OBJ[S].VPos & 0xff); line < Height; Y++, line += inc)
+			for (int i = 0; i < 128; i++)
+			{
+				if (IPPU.OBJDirty[i >> 5] & (1 << (i & 31)))
 				{
-					if (Y >= SNES_HEIGHT_EXTENDED)
-						continue;
-
-					if (LineOBJ[Y] >= sprite_limit)
-					{
-						GFX.OBJLines[Y].RTOFlags |= 0x40;
-						continue;
-					}
-
-					GFX.OBJLines[Y].Tiles -= GFX.OBJVisibleTiles[S];
-					if (GFX.OBJLines[Y].Tiles < 0)
-						GFX.OBJLines[Y].RTOFlags |= 0x80;
-
-					GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Sprite = S;
-					if (PPU.OBJ[S].VFlip)
-						// Yes, Width not Height. It so happens that the
-						// sprites with H=2*W flip as two WxW sprites.
-						GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Line = line ^ (GFX.OBJWidths[S] - 1);
-					else
-						GFX.OBJLines[Y].OBJ[LineOBJ[Y]].Line = line;
-
-					LineOBJ[Y]++;
+					UnlinkOBJ(i, LineChanged);
+					SetupOBJGeometry(i, SmallWidth, SmallHeight, LargeWidth, LargeHeight);
+					LinkOBJ(i, LineChanged);
 				}
 			}
 
-			S = (S + 1) & 0x7f;
-		} while (S != FirstSprite);
+			for (int Y = 0; Y < SNES_HEIGHT_EXTENDED; Y++)
+			{
+				if (LineChanged[Y])
+					BuildOBJLine(Y);
+			}
 
+			IPPU.OBJPartialSetups++;
+		}
+
+		GFX.OBJLines[0].RTOFlags = OBJIndex.RTOFlags[0];
 		for (int Y = 1; Y < SNES_HEIGHT_EXTENDED; Y++)
-			GFX.OBJLines[Y].RTOFlags |= GFX.OBJLines[Y - 1].RTOFlags;
+			GFX.OBJLines[Y].RTOFlags = OBJIndex.RTOFlags[Y] | GFX.OBJLines[Y - 1].RTOFlags;
+
+		OBJIndex.Valid = TRUE;
 	}
 	else // evil FirstSprite+Y case
 	{
@@ -778,9 +996,13 @@ static void SetupOBJ (void)
 			if (j < sprite_limit)
 				GFX.OBJLines[Y].OBJ[j].Sprite = -1;
 		}
+
+		OBJIndex.Valid = FALSE;
 	}
 
 	IPPU.OBJChanged = FALSE;
+	IPPU.OBJEntriesChanged = FALSE;
+	memset(IPPU.OBJDirty, 0, sizeof(IPPU.OBJDirty));
 }
 
 #if defined(__GNUC__) && !defined(__clang__)
@@ -1858,8 +2080,8 @@ static void DisplayTime (void)
 static void DisplayFrameRate (void)
 {
 	char	string[10];
-	static uint32 lastFrameCount = 0, calcFps = 0;
-	static time_t lastTime = time(NULL);
+	static S9X_INSTANCE uint32 lastFrameCount = 0, calcFps = 0;
+	static S9X_INSTANCE time_t lastTime = time(NULL);
 
 	time_t currTime = time(NULL);
 	if (lastTime != currTime) {
@@ -17,7 +17,7 @@ enum
     NUM_COLS
 };
 
-extern SCheatData Cheat;
+extern S9X_INSTANCE SCheatData Cheat;
 
 static void
 display_errorbox (const char *error)
@@ -235,6 +235,7 @@ static void cheat_move (int src, int dst)
     if (dst < src)
         src++;
     Cheat.g.erase (Cheat.g.begin() + src);
+    Cheat.patches_valid = false;
 }
 
 static void cheat_gather_enabled ()
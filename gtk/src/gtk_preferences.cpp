@@ -876,6 +876,9 @@ Snes9xPreferences::get_settings_from_dialog ()
         Settings.TwoClockCycles = 12;
     }
 
+    // the access speed table caches the cycle counts
+    Memory.UpdateSpeedMap ();
+
     if (get_check ("remove_sprite_limit"))
     {
         Settings.MaxSpriteTilesPerLine = 128;
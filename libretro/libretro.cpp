@@ -420,6 +420,9 @@ static void update_variables(void)
         }
     }
 
+    // the access speed table caches the cycle counts
+    Memory.UpdateSpeedMap();
+
     Settings.MaxSpriteTilesPerLine = 34;
     var.key="snes9x_reduce_sprite_flicker";
     var.value=NULL;
@@ -4,18 +4,199 @@
    For further information, consult the LICENSE file in the root directory.
 \*****************************************************************************/
 
+// Stream dumping.
+// The emulation thread only copies frames and samples into a small ring of
+// packets; a writer thread drains it into a single container file:
+//
+//   "S9XDUMP\1"
+//   chunks:  fourcc[4] frame[4] length[4] payload[length]
+//     VFRM   width[2] height[2] depth[2] flags[2] + zlib data
+//            flags & 1: data is XORed with the previous frame
+//     VDUP   no payload, previous frame repeated
+//     AUDI   raw samples as passed to S9xAudioLogger
+//     INDX   entries of fourcc[4] frame[4] offset[4], one per chunk above
+//   trailer: INDX offset[4] "S9XE"
+//
+// All integers are little-endian.
+
+#include <string.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "snes9x.h"
 #include "movie.h"
 #include "logger.h"
 
+#define LOGGER_QUEUE_SIZE	8
+
+enum
+{
+	PACKET_VIDEO,
+	PACKET_AUDIO
+};
+
+struct SLoggerPacket
+{
+	int		type;
+	uint32	frame;
+	uint16	width, height, depth;
+	std::vector<uint8>	data;
+};
+
+struct SLoggerIndex
+{
+	char	fourcc[4];
+	uint32	frame;
+	uint32	offset;
+};
+
 static int	resetno = 0;
 static int	framecounter = 0;
-static FILE	*video = NULL;
-static FILE	*audio = NULL;
+static FILE	*dump = NULL;
+
+static SLoggerPacket			queue[LOGGER_QUEUE_SIZE];
+static int						queue_head = 0, queue_count = 0;
+static bool						writer_quit = false;
+static std::mutex				queue_lock;
+static std::condition_variable	queue_cond;
+static std::thread				writer;
+
+// writer thread state
+static std::vector<uint8>			prev_frame, delta_frame, zbuf;
+static uint16						prev_width, prev_height, prev_depth;
+static std::vector<SLoggerIndex>	dump_index;
+static bool							write_error;
+
+static void PutLE32 (uint8 *p, uint32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void PutLE16 (uint8 *p, uint16 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void WriteChunk (const char *fourcc, uint32 frame, const uint8 *head, uint32 headlen, const uint8 *data, uint32 datalen)
+{
+	SLoggerIndex	ent;
+	uint8			hdr[12];
+
+	memcpy(ent.fourcc, fourcc, 4);
+	ent.frame = frame;
+	ent.offset = ftell(dump);
+	dump_index.push_back(ent);
+
+	memcpy(hdr, fourcc, 4);
+	PutLE32(hdr + 4, frame);
+	PutLE32(hdr + 8, headlen + datalen);
+
+	if (fwrite(hdr, 1, 12, dump) != 12 ||
+		(headlen && fwrite(head, 1, headlen, dump) != headlen) ||
+		(datalen && fwrite(data, 1, datalen, dump) != datalen))
+	{
+		if (!write_error)
+			printf("Error writing stream dump.\n");
+		write_error = true;
+	}
+}
+
+static void WriteVideo (SLoggerPacket *p)
+{
+	size_t	size = p->data.size();
+	bool	same_format = p->width == prev_width && p->height == prev_height && p->depth == prev_depth && prev_frame.size() == size;
+
+	if (same_format && memcmp(prev_frame.data(), p->data.data(), size) == 0)
+	{
+		WriteChunk("VDUP", p->frame, NULL, 0, NULL, 0);
+		return;
+	}
+
+	// XOR against the previous frame leaves mostly zeroes for zlib
+	const uint8	*src = p->data.data();
+	if (same_format)
+	{
+		delta_frame.resize(size);
+		for (size_t i = 0; i < size; i++)
+			delta_frame[i] = src[i] ^ prev_frame[i];
+		src = delta_frame.data();
+	}
+
+	uLongf	zlen = compressBound(size);
+	zbuf.resize(zlen);
+	if (compress2(zbuf.data(), &zlen, src, size, 1) != Z_OK)
+	{
+		printf("Error compressing video data.\n");
+		return;
+	}
+
+	uint8	head[8];
+	PutLE16(head + 0, p->width);
+	PutLE16(head + 2, p->height);
+	PutLE16(head + 4, p->depth);
+	PutLE16(head + 6, same_format ? 1 : 0);
+	WriteChunk("VFRM", p->frame, head, 8, zbuf.data(), zlen);
+
+	prev_frame.swap(p->data);
+	prev_width = p->width;
+	prev_height = p->height;
+	prev_depth = p->depth;
+}
+
+static void WriterThread (void)
+{
+	std::unique_lock<std::mutex>	lock(queue_lock);
+
+	for (;;)
+	{
+		queue_cond.wait(lock, [] { return queue_count > 0 || writer_quit; });
+		if (queue_count == 0)
+			break;
 
+		SLoggerPacket	*p = &queue[queue_head];
+
+		// the slot stays owned by the writer until it is released below
+		lock.unlock();
+		if (p->type == PACKET_VIDEO)
+			WriteVideo(p);
+		else
+			WriteChunk("AUDI", p->frame, NULL, 0, p->data.data(), p->data.size());
+		lock.lock();
+
+		queue_head = (queue_head + 1) % LOGGER_QUEUE_SIZE;
+		queue_count--;
+		queue_cond.notify_all();
+	}
+}
+
+// Returns a free slot, waiting for the writer only if the queue is full.
+static SLoggerPacket * AcquirePacket (void)
+{
+	std::unique_lock<std::mutex>	lock(queue_lock);
+
+	queue_cond.wait(lock, [] { return queue_count < LOGGER_QUEUE_SIZE; });
+	return &queue[(queue_head + queue_count) % LOGGER_QUEUE_SIZE];
+}
+
+static void SubmitPacket (void)
+{
+	std::lock_guard<std::mutex>	lock(queue_lock);
+
+	queue_count++;
+	queue_cond.notify_all();
+}
 
 void S9xResetLogger (void)
 {
+	static bool	registered = false;
+
 	if (!Settings.DumpStreams)
 		return;
 
@@ -24,40 +205,65 @@ void S9xResetLogger (void)
 	S9xCloseLogger();
 	framecounter = 0;
 
-	sprintf(buffer, "videostream%d.dat", resetno);
-	video = fopen(buffer, "wb");
-	if (!video)
+	sprintf(buffer, "dumpstream%d.s9d", resetno);
+	dump = fopen(buffer, "wb");
+	if (!dump)
 	{
 		printf("Opening %s failed. Logging cancelled.\n", buffer);
 		return;
 	}
 
-	sprintf(buffer, "audiostream%d.dat", resetno);
-	audio = fopen(buffer, "wb");
-	if (!audio)
+	fwrite("S9XDUMP\1", 1, 8, dump);
+
+	if (!registered)
 	{
-		printf("Opening %s failed. Logging cancelled.\n", buffer);
-		fclose(video);
-		return;
+		atexit(S9xCloseLogger);
+		registered = true;
 	}
 
+	prev_frame.clear();
+	prev_width = prev_height = prev_depth = 0;
+	dump_index.clear();
+	write_error = false;
+	queue_head = queue_count = 0;
+	writer_quit = false;
+	writer = std::thread(WriterThread);
+
 	resetno++;
 }
 
 void S9xCloseLogger (void)
 {
-	if (video)
+	if (!dump)
+		return;
+
 	{
-		fclose(video);
-		video = NULL;
+		std::lock_guard<std::mutex>	lock(queue_lock);
+		writer_quit = true;
+		queue_cond.notify_all();
 	}
+	writer.join();
 
-	if (audio)
+	uint32	index_offset = ftell(dump);
+	std::vector<uint8>	index(dump_index.size() * 12);
+	for (size_t i = 0; i < dump_index.size(); i++)
 	{
-		fclose(audio);
-		audio = NULL;
+		memcpy(&index[i * 12], dump_index[i].fourcc, 4);
+		PutLE32(&index[i * 12 + 4], dump_index[i].frame);
+		PutLE32(&index[i * 12 + 8], dump_index[i].offset);
 	}
-}	
+	WriteChunk("INDX", 0, NULL, 0, index.data(), index.size());
+
+	uint8	trailer[8];
+	PutLE32(trailer, index_offset);
+	memcpy(trailer + 4, "S9XE", 4);
+	fwrite(trailer, 1, 8, dump);
+
+	fclose(dump);
+	dump = NULL;
+	dump_index.clear();
+	prev_frame.clear();
+}
 
 void S9xVideoLogger (void *pixels, int width, int height, int depth, int bytes_per_line)
 {
@@ -67,32 +273,39 @@ void S9xVideoLogger (void *pixels, int width, int height, int depth, int bytes_p
 	else
 		framecounter++;
 
-	if (video)
+	if (dump)
 	{
-		char	*data = (char *) pixels;
+		SLoggerPacket	*p = AcquirePacket();
+		char			*data = (char *) pixels;
+		int				linebytes = width * depth;
 
+		p->type = PACKET_VIDEO;
+		p->frame = framecounter;
+		p->width = width;
+		p->height = height;
+		p->depth = depth;
+		p->data.resize(linebytes * height);
 		for (int i = 0; i < height; i++)
-		{
-			if (!fwrite(data + i * bytes_per_line, depth, width, video))
-				printf ("Error writing video data.\n");
-		}
-		fflush(video);
-		fflush(audio);
+			memcpy(&p->data[i * linebytes], data + i * bytes_per_line, linebytes);
+		SubmitPacket();
 
 		if (Settings.DumpStreamsMaxFrames > 0 && framecounter >= Settings.DumpStreamsMaxFrames)
 		{
 			printf("Logging ended.\n");
 			S9xCloseLogger();
 		}
-
 	}
 }
 
 void S9xAudioLogger (void *samples, int length)
 {
-	if (audio)
+	if (dump)
 	{
-		if (!fwrite(samples, 1, length, audio))
-			printf ("Error writing audio data.\n");
+		SLoggerPacket	*p = AcquirePacket();
+
+		p->type = PACKET_AUDIO;
+		p->frame = framecounter;
+		p->data.assign((uint8 *) samples, (uint8 *) samples + length);
+		SubmitPacket();
 	}
 }
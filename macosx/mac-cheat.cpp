@@ -39,7 +39,7 @@
 #define	kDelButton		'DEL_'
 #define	kAllButton		'ALL_'
 
-extern SCheatData	Cheat;
+extern S9X_INSTANCE SCheatData	Cheat;
 
 typedef struct
 {
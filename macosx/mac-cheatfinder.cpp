@@ -110,7 +110,7 @@ typedef struct
 
 Boolean	cfIsWatching = false;
 
-extern SCheatData	Cheat;
+extern S9X_INSTANCE SCheatData	Cheat;
 
 static UInt8		*cfStoredRAM;
 static UInt8		*cfLastRAM;
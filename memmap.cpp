@@ -22,6 +22,15 @@
 
 #include <ctype.h>
 #include <sys/stat.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 #include "snes9x.h"
 #include "memmap.h"
@@ -47,8 +56,8 @@
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #endif
 
-static bool8	stopMovie = TRUE;
-static char		LastRomFilename[PATH_MAX + 1] = "";
+static S9X_INSTANCE bool8	stopMovie = TRUE;
+static S9X_INSTANCE char		LastRomFilename[PATH_MAX + 1] = "";
 
 // from NSRT
 static const char	*nintendo_licensees[] =
@@ -977,6 +986,7 @@ bool8 CMemory::Init (void)
 	SuperFX.pvRom       = (uint8 *) ROM;
 
 	PostRomInitFunc = NULL;
+	KnownIdentity.Valid = FALSE;
 
 	return (TRUE);
 }
@@ -1388,7 +1398,11 @@ bool8 CMemory::LoadROMMem (const uint8 *source, uint32 sourceSize)
 bool8 CMemory::LoadROM (const char *filename)
 {
     if(!filename || !*filename)
+    {
+        // the identity was for this file, it must not carry over to another
+        KnownIdentity.Valid = FALSE;
         return FALSE;
+    }
 
     int32 totalFileSize;
 
@@ -1399,7 +1413,10 @@ bool8 CMemory::LoadROM (const char *filename)
         totalFileSize = FileLoader(ROM, filename, MAX_ROM_SIZE);
 
         if (!totalFileSize)
+        {
+            KnownIdentity.Valid = FALSE;
             return (FALSE);
+        }
 
         CheckForAnyPatch(filename, HeaderCount != 0, totalFileSize);
     }
@@ -1914,6 +1931,184 @@ void CMemory::ClearSRAM (bool8 onlyNonSavedSRAM)
 	memset(SRAM, SNESGameFixes.SRAMInitialValue, 0x20000);
 }
 
+// SRAM persistence.
+// Autosaves hash the SRAM in pages and compare against the image last handed
+// to disk, so games that use SRAM as scratch memory don't rewrite an
+// unchanged file. Real changes are copied and written by a background thread
+// to a temporary file that is synced and renamed over the old one.
+// Hashes and queued writes are kept per file, as emulator threads share them.
+
+#define SRAM_PAGE_SIZE	0x400
+#define SRAM_PAGES		(0x20000 / SRAM_PAGE_SIZE)
+
+struct SSRAMFile
+{
+	char				name[PATH_MAX + 1];
+	uint32				page_hash[SRAM_PAGES];
+	int					saved_size;	// 0 = nothing known about the file on disk
+	std::vector<uint8>	job;		// newest image waiting to be written
+	bool				pending, busy;
+};
+
+static std::vector<SSRAMFile>	sram_files;
+static int						sram_jobs = 0;	// files with a pending write
+static bool						sram_writer_started = false, sram_writer_quit = false;
+static std::mutex				sram_lock;
+static std::condition_variable	sram_cond;
+static std::thread				sram_writer;
+
+static uint32 HashSRAMPage (const uint8 *p)
+{
+	uint32	h = 2166136261u;
+
+	for (int i = 0; i < SRAM_PAGE_SIZE; i += 4)
+		h = (h ^ READ_DWORD(p + i)) * 16777619u;
+
+	return (h);
+}
+
+// Called with sram_lock held. Entries stay for the session, one per SRAM file used.
+static SSRAMFile * FindSRAMFile (const char *filename, bool create)
+{
+	for (size_t i = 0; i < sram_files.size(); i++)
+		if (!strcmp(sram_files[i].name, filename))
+			return (&sram_files[i]);
+
+	if (!create)
+		return (NULL);
+
+	sram_files.resize(sram_files.size() + 1);
+
+	SSRAMFile	*f = &sram_files.back();
+	strcpy(f->name, filename);
+	f->saved_size = 0;
+	f->pending = f->busy = false;
+
+	return (f);
+}
+
+// Returns true if any page differs from the last persisted image, updating the hashes.
+static bool UpdateSRAMHashes (SSRAMFile *f, const uint8 *sram, int size)
+{
+	bool	changed = size != f->saved_size;
+
+	for (int i = 0; i < (size + SRAM_PAGE_SIZE - 1) / SRAM_PAGE_SIZE; i++)
+	{
+		uint32	h = HashSRAMPage(sram + i * SRAM_PAGE_SIZE);
+
+		if (h != f->page_hash[i])
+		{
+			f->page_hash[i] = h;
+			changed = true;
+		}
+	}
+
+	f->saved_size = size;
+
+	return (changed);
+}
+
+static bool WriteSRAMFile (const char *filename, const uint8 *data, int size)
+{
+	char	tmpname[PATH_MAX + 8];
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+
+	FILE	*file = fopen(tmpname, "wb");
+	if (!file)
+		return (false);
+
+	bool	ok = fwrite(data, size, 1, file) == 1 && fflush(file) == 0;
+#ifdef _WIN32
+	ok = ok && _commit(_fileno(file)) == 0;
+#else
+	ok = ok && fsync(fileno(file)) == 0;
+#endif
+	ok = (fclose(file) == 0) && ok;
+
+#ifdef _WIN32
+	// rename() doesn't replace an existing file here
+	if (ok)
+		remove(filename);
+#endif
+	if (!ok || rename(tmpname, filename) != 0)
+	{
+		remove(tmpname);
+		return (false);
+	}
+
+	return (true);
+}
+
+static void SRAMWriterThread (void)
+{
+	std::unique_lock<std::mutex>	lock(sram_lock);
+	std::vector<uint8>				data;
+	char							name[PATH_MAX + 1];
+
+	for (;;)
+	{
+		sram_cond.wait(lock, [] { return sram_jobs > 0 || sram_writer_quit; });
+		if (!sram_jobs)
+			break;
+
+		SSRAMFile	*f = &sram_files[0];
+		while (!f->pending)
+			f++;
+
+		data.swap(f->job);
+		strcpy(name, f->name);
+		f->pending = false;
+		f->busy = true;
+		sram_jobs--;
+
+		// the vector may grow while unlocked, so the entry is looked up again
+		lock.unlock();
+		bool	ok = WriteSRAMFile(name, data.data(), data.size());
+		lock.lock();
+
+		f = FindSRAMFile(name, false);
+		if (!ok)
+		{
+			printf("Couldn't write to SRAM file.\n");
+			// force the next autosave to try again
+			f->saved_size = 0;
+		}
+
+		f->busy = false;
+		sram_cond.notify_all();
+	}
+}
+
+static void StopSRAMWriter (void)
+{
+	{
+		std::lock_guard<std::mutex>	lock(sram_lock);
+		sram_writer_quit = true;
+		sram_cond.notify_all();
+	}
+	sram_writer.join();
+}
+
+// Records what the file on disk now holds; a NULL image means unknown.
+static void RecordPersistedSRAM (const uint8 *sram, int size, const char *filename)
+{
+	std::lock_guard<std::mutex>	lock(sram_lock);
+	SSRAMFile					*f = FindSRAMFile(filename, true);
+
+	if (sram)
+		UpdateSRAMHashes(f, sram, size);
+	else
+		f->saved_size = 0;
+}
+
+// Waits until no background write to this file is queued or running.
+static void FlushSRAMWrites (const char *filename)
+{
+	std::unique_lock<std::mutex>	lock(sram_lock);
+
+	sram_cond.wait(lock, [filename] { SSRAMFile *f = FindSRAMFile(filename, false); return !f || (!f->pending && !f->busy); });
+}
+
 bool8 CMemory::LoadSRAM (const char *filename)
 {
 	FILE	*file;
@@ -1922,6 +2117,9 @@ bool8 CMemory::LoadSRAM (const char *filename)
 
 	strcpy(sramName, filename);
 
+	FlushSRAMWrites(sramName);
+	RecordPersistedSRAM(NULL, 0, sramName);
+
 	ClearSRAM();
 
 	if (Multi.cartType && Multi.sramSizeB)
@@ -1959,6 +2157,10 @@ bool8 CMemory::LoadSRAM (const char *filename)
 			if (len - size == 512)
 				memmove(SRAM, SRAM + 512, size);
 
+			// the file already holds this image unless it was short or had a header
+			if (len == size)
+				RecordPersistedSRAM(SRAM, size, sramName);
+
 			if (Settings.SRTC || Settings.SPC7110RTC)
 				LoadSRTC();
 
@@ -2013,6 +2215,9 @@ bool8 CMemory::SaveSRAM (const char *filename)
 
 	strcpy(sramName, filename);
 
+	// a queued autosave must not land on top of this one
+	FlushSRAMWrites(sramName);
+
 	if (Multi.cartType && Multi.sramSizeB)
 	{
 		char	name[PATH_MAX + 1], temp[PATH_MAX + 1];
@@ -2044,7 +2249,12 @@ bool8 CMemory::SaveSRAM (const char *filename)
 		if (file)
 		{
 			if (!fwrite((char *) SRAM, size, 1, file))
+			{
 				printf ("Couldn't write to SRAM file.\n");
+				RecordPersistedSRAM(NULL, 0, sramName);
+			}
+			else
+				RecordPersistedSRAM(SRAM, size, sramName);
 			fclose(file);
 
 			if (Settings.SRTC || Settings.SPC7110RTC)
@@ -2057,6 +2267,54 @@ bool8 CMemory::SaveSRAM (const char *filename)
 	return (FALSE);
 }
 
+bool8 CMemory::AutoSaveSRAM (const char *filename)
+{
+	if (Settings.SuperFX && ROMType < 0x15) // doesn't have SRAM
+		return (TRUE);
+
+	if (Settings.SA1 && ROMType == 0x34)    // doesn't have SRAM
+		return (TRUE);
+
+	// the subcart SRAM is rare enough to keep on the synchronous path
+	if (Multi.cartType && Multi.sramSizeB)
+		return (SaveSRAM(filename));
+
+	int	size = SRAMSize ? (1 << (SRAMSize + 3)) * 128 : 0;
+	if (size > 0x20000)
+		size = 0x20000;
+
+	if (!size)
+		return (FALSE);
+
+	std::unique_lock<std::mutex>	lock(sram_lock);
+	SSRAMFile						*f = FindSRAMFile(filename, true);
+
+	if (!UpdateSRAMHashes(f, SRAM, size))
+		return (TRUE);
+
+	if (!sram_writer_started)
+	{
+		sram_writer = std::thread(SRAMWriterThread);
+		sram_writer_started = true;
+		atexit(StopSRAMWriter);
+	}
+
+	// a write of this file still waiting in the queue is replaced by the newer image
+	f->job.assign(SRAM, SRAM + size);
+	if (!f->pending)
+	{
+		f->pending = true;
+		sram_jobs++;
+	}
+	sram_cond.notify_all();
+	lock.unlock();
+
+	if (Settings.SRTC || Settings.SPC7110RTC)
+		SaveSRTC();
+
+	return (TRUE);
+}
+
 bool8 CMemory::SaveMPAK (const char *filename)
 {
 	if (Settings.BS || (Multi.cartSizeB && (Multi.cartType == 3)))
@@ -2095,8 +2353,8 @@ static uint32 caCRC32 (uint8 *array, uint32 size, uint32 crc32)
 
 char * CMemory::Safe (const char *s)
 {
-	static char	*safe = NULL;
-	static int	safe_len = 0;
+	static S9X_INSTANCE char	*safe = NULL;
+	static S9X_INSTANCE int	safe_len = 0;
 
 	if (s == NULL)
 	{
@@ -2134,8 +2392,8 @@ char * CMemory::Safe (const char *s)
 
 char * CMemory::SafeANK (const char *s)
 {
-	static char	*safe = NULL;
-	static int	safe_len = 0;
+	static S9X_INSTANCE char	*safe = NULL;
+	static S9X_INSTANCE int	safe_len = 0;
 
 	if (s == NULL)
 	{
@@ -2490,7 +2748,13 @@ void CMemory::InitROM (void)
 			Map_LoROMMap();
     }
 
-	Checksum_Calculate();
+	bool8	known = KnownIdentity.Valid && !Settings.IsPatched && KnownIdentity.Size == CalculatedSize;
+	KnownIdentity.Valid = FALSE;
+
+	if (known)
+		CalculatedChecksum = KnownIdentity.Checksum;
+	else
+		Checksum_Calculate();
 
 	bool8 isChecksumOK = (ROMChecksum + ROMComplementChecksum == 0xffff) &
 						 (ROMChecksum == CalculatedChecksum);
@@ -2498,6 +2762,12 @@ void CMemory::InitROM (void)
 	//// Build more ROM information
 
 	// CRC32
+	if (known)
+	{
+		ROMCRC32 = KnownIdentity.CRC32;
+		memcpy(ROMSHA256, KnownIdentity.SHA256, 32);
+	}
+	else
 	if (!Settings.BS || Settings.BSXItself) // Not BS Dump
 	{
 		ROMCRC32 = caCRC32(ROM, CalculatedSize);
@@ -2888,6 +3158,46 @@ void CMemory::map_WriteProtectROM (void)
 	}
 }
 
+void CMemory::UpdateSpeedMap (void)
+{
+	// Must be called again whenever CPU.FastROMSpeed or the overclock cycle settings change.
+	for (uint32 c = 0; c < MEMMAP_NUM_BLOCKS; c++)
+	{
+		uint32	address = c << MEMMAP_SHIFT;
+
+		if (address & 0x408000)
+			SpeedMap[c] = (address & 0x800000) ? CPU.FastROMSpeed : SLOW_ONE_CYCLE;
+		else
+		if ((address + 0x6000) & 0x4000)
+			SpeedMap[c] = SLOW_ONE_CYCLE;
+		else
+		if ((address & 0xf000) == 0x4000)
+			SpeedMap[c] = 0; // $4000-$41FF is slower than the rest of the block
+		else
+			SpeedMap[c] = ONE_CYCLE;
+	}
+}
+
+void CMemory::map_SA1Shared (uint32 bwram_bank_e)
+{
+	// Only called after the SA-1 map has been copied, so the SA-1 itself keeps direct access.
+	memset((void *) SA1.SharedMap, 0, sizeof(SA1.SharedMap));
+
+	if (!Settings.SA1SyncQuantum)
+		return;
+
+	for (uint32 c = 0; c < MEMMAP_NUM_BLOCKS; c++)
+	{
+		uint32	bank = (c >> 4) & 0x7f;
+
+		if ((bank < 0x40 && (c & 0xf) == 3) || (bank >= 0x40 && bank <= bwram_bank_e && c < 0x800))
+		{
+			SA1.SharedMap[c] = Map[c];
+			Map[c] = WriteMap[c] = (uint8 *) MAP_SA1_SHARED;
+		}
+	}
+}
+
 void CMemory::Map_Initialize (void)
 {
 	for (int c = 0; c < 0x1000; c++)
@@ -3161,6 +3471,8 @@ void CMemory::Map_SA1LoROMMap (void)
 	for (int c = 0x600; c < 0x700; c++)
 		SA1.Map[c] = SA1.WriteMap[c] = (uint8 *) MAP_BWRAM_BITMAP;
 
+	map_SA1Shared(0x4e);
+
 	BWRAM = SRAM;
 }
 
@@ -3203,6 +3515,8 @@ void CMemory::Map_BSSA1LoROMMap(void)
 	for (int c = 0x600; c < 0x700; c++)
 		SA1.Map[c] = SA1.WriteMap[c] = (uint8 *) MAP_BWRAM_BITMAP;
 
+	map_SA1Shared(0x7f);
+
 	BWRAM = SRAM;
 }
 
@@ -3401,7 +3715,7 @@ const char * CMemory::MapType (void)
 
 const char * CMemory::StaticRAMSize (void)
 {
-	static char	str[20];
+	static S9X_INSTANCE char	str[20];
 
 	if (SRAMSize > 16)
 		strcpy(str, "Corrupt");
@@ -3413,7 +3727,7 @@ const char * CMemory::StaticRAMSize (void)
 
 const char * CMemory::Size (void)
 {
-	static char	str[20];
+	static S9X_INSTANCE char	str[20];
 
 	if (Multi.cartType == 4)
 		strcpy(str, "N/A");
@@ -3428,7 +3742,7 @@ const char * CMemory::Size (void)
 
 const char * CMemory::Revision (void)
 {
-	static char	str[20];
+	static S9X_INSTANCE char	str[20];
 
 	sprintf(str, "1.%d", HiROM ? ((ExtendedFormat != NOPE) ? ROM[0x40ffdb] : ROM[0xffdb]) : ROM[0x7fdb]);
 
@@ -3437,7 +3751,7 @@ const char * CMemory::Revision (void)
 
 const char * CMemory::KartContents (void)
 {
-	static char			str[64];
+	static S9X_INSTANCE char			str[64];
 	static const char	*contents[3] = { "ROM", "ROM+RAM", "ROM+RAM+BAT" };
 
 	char	chip[20];
@@ -46,6 +46,7 @@ struct CMemory
 		MAP_SETA_DSP,
 		MAP_SETA_RISC,
 		MAP_BSX,
+		MAP_SA1_SHARED,
 		MAP_NONE,
 		MAP_LAST
 	};
@@ -68,6 +69,7 @@ struct CMemory
 	uint8	*WriteMap[MEMMAP_NUM_BLOCKS];
 	uint8	BlockIsRAM[MEMMAP_NUM_BLOCKS];
 	uint8	BlockIsROM[MEMMAP_NUM_BLOCKS];
+	uint8	SpeedMap[MEMMAP_NUM_BLOCKS];	// access cycles per block, 0 for $xx4000-$xx4FFF
 	uint8	ExtendedFormat;
 
 	char	ROMFilename[PATH_MAX + 1];
@@ -92,6 +94,18 @@ struct CMemory
 	uint32	CalculatedSize;
 	uint32	CalculatedChecksum;
 
+	// ports that already know the identity of the image about to be loaded
+	// (e.g. from an earlier run) can fill this in to skip hashing the ROM;
+	// it is only used once and ignored for patched or differently sized images
+	struct
+	{
+		bool8	Valid;
+		uint32	Size;
+		uint32	Checksum;
+		uint32	CRC32;
+		unsigned char SHA256[32];
+	}		KnownIdentity;
+
 	// ports can assign this to perform some custom action upon loading a ROM (such as adjusting controls)
 	void	(*PostRomInitFunc) (void);
 
@@ -115,6 +129,7 @@ struct CMemory
 	bool8	LoadGNEXT ();
 	bool8	LoadSRAM (const char *);
 	bool8	SaveSRAM (const char *);
+	bool8	AutoSaveSRAM (const char *);
 	void	ClearSRAM (bool8 onlyNonSavedSRAM = 0);
 	bool8	LoadSRTC (void);
 	bool8	SaveSRTC (void);
@@ -142,6 +157,8 @@ struct CMemory
 	void	map_SetaRISC (void);
 	void	map_SetaDSP (void);
 	void	map_WriteProtectROM (void);
+	void	map_SA1Shared (uint32);
+	void	UpdateSpeedMap (void);
 	void	Map_Initialize (void);
 	void	Map_LoROMMap (void);
 	void	Map_NoMAD1LoROMMap (void);
@@ -194,8 +211,8 @@ struct SMulti
 	char	fileNameA[PATH_MAX + 1], fileNameB[PATH_MAX + 1];
 };
 
-extern CMemory	Memory;
-extern SMulti	Multi;
+extern S9X_INSTANCE CMemory	Memory;
+extern S9X_INSTANCE SMulti	Multi;
 
 void S9xAutoSaveSRAM (void);
 bool8 LoadZip(const char *, uint32 *, uint8 *);
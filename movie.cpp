@@ -10,6 +10,7 @@
 #ifndef __WIN32__
 #include <unistd.h>
 #endif
+#include <chrono>
 #include "snes9x.h"
 #include "memmap.h"
 #include "controls.h"
@@ -33,6 +34,9 @@
 #define SMV_HEADER_SIZE			64
 #define SMV_EXTRAROMINFO_SIZE	30
 #define BUFFER_GROWTH_SIZE		4096
+#define SMK_MAGIC				0x314b4d53 // SMK1
+#define SMK_HEADER_SIZE			12
+#define SMK_ENTRY_SIZE			16
 
 enum MovieState
 {
@@ -71,13 +75,30 @@ struct SMovie
 	uint8	*InputBuffer;
 	uint8	*InputBufferPtr;
 	uint32	InputBufferSize;
+	uint32	FlushedSamples;	// leading samples of InputBuffer known to be on disk
+
+	FILE	*KeyFile;		// sidecar with a savestate every KeyInterval frames
+	uint32	KeyInterval;
+	bool8	KeyPending;
+	struct SMovieKeyframe	*Keys;
+	uint32	NumKeys;
+	uint32	KeysSize;
 };
 
-static struct SMovie	Movie;
+struct SMovieKeyframe
+{
+	uint32	Frame;
+	uint32	Sample;
+	uint32	Offset;		// of the entry in the sidecar
+	uint32	StateSize;	// uncompressed
+	uint32	DataSize;	// stored
+};
+
+static S9X_INSTANCE struct SMovie	Movie;
 
-static uint8	prevPortType[2];
-static int8		prevPortIDs[2][4];
-static bool8	prevMouseMaster, prevSuperScopeMaster, prevJustifierMaster, prevMultiPlayer5Master;
+static S9X_INSTANCE uint8	prevPortType[2];
+static S9X_INSTANCE int8		prevPortIDs[2][4];
+static S9X_INSTANCE bool8	prevMouseMaster, prevSuperScopeMaster, prevJustifierMaster, prevMultiPlayer5Master;
 
 static uint8	Read8 (uint8 *&);
 static uint16	Read16 (uint8 *&);
@@ -94,6 +115,7 @@ static void		reserve_buffer_space (uint32);
 static void		reset_controllers (void);
 static void		read_frame_controller_data (bool);
 static void		write_frame_controller_data (void);
+static void		write_sample (uint32);
 static void		flush_movie (void);
 static void		truncate_movie (void);
 static int		read_movie_header (FILE *, SMovie *);
@@ -101,6 +123,12 @@ static int		read_movie_extrarominfo (FILE *, SMovie *);
 static void		write_movie_header (FILE *, SMovie *);
 static void		write_movie_extrarominfo (FILE *, SMovie *);
 static void		change_state (MovieState);
+static void		open_keyframes (void);
+static void		close_keyframes (void);
+static void		add_keyframe (struct SMovieKeyframe *);
+static void		trim_keyframes (uint32, uint32);
+static void		capture_keyframe (void);
+static bool8	restore_keyframe (struct SMovieKeyframe *);
 
 // HACK: reduce movie size by not storing changes that can only affect polled input in the movie for these types,
 //       because currently no port sets these types to polling
@@ -226,10 +254,14 @@ static void reserve_buffer_space (uint32 space_needed)
 {
 	if (space_needed > Movie.InputBufferSize)
 	{
-		uint32 ptr_offset   = Movie.InputBufferPtr - Movie.InputBuffer;
-		uint32 alloc_chunks = space_needed / BUFFER_GROWTH_SIZE;
+		uint32 ptr_offset = Movie.InputBufferPtr - Movie.InputBuffer;
+
+		// grow geometrically so long recordings don't keep copying the buffer
+		if (!Movie.InputBufferSize)
+			Movie.InputBufferSize = BUFFER_GROWTH_SIZE;
+		while (Movie.InputBufferSize <= space_needed)
+			Movie.InputBufferSize <<= 1;
 
-		Movie.InputBufferSize = BUFFER_GROWTH_SIZE * (alloc_chunks + 1);
 		Movie.InputBuffer     = (uint8 *) realloc(Movie.InputBuffer, Movie.InputBufferSize);
 		Movie.InputBufferPtr  = Movie.InputBuffer + ptr_offset;
 	}
@@ -357,17 +389,39 @@ static void write_frame_controller_data (void)
 	}
 }
 
+// Appends the sample at the current file position, which must be where it belongs.
+static void write_sample (uint32 sample)
+{
+	if (!fwrite(Movie.InputBuffer + Movie.BytesPerSample * sample, 1, Movie.BytesPerSample, Movie.File))
+		printf ("Error writing control data.\n");
+
+	if (sample == Movie.FlushedSamples)
+		Movie.FlushedSamples++;
+}
+
+// Patches the header in place and writes only the samples that aren't on disk yet.
 static void flush_movie (void)
 {
 	if (!Movie.File)
 		return;
 
+	long	pos = ftell(Movie.File);
+
 	fseek(Movie.File, 0, SEEK_SET);
 	write_movie_header(Movie.File, &Movie);
-	fseek(Movie.File, Movie.ControllerDataOffset, SEEK_SET);
 
-	if (!fwrite(Movie.InputBuffer, 1, Movie.BytesPerSample * (Movie.MaxSample + 1), Movie.File))
-		printf ("Movie flush failed.\n");
+	if (Movie.FlushedSamples < Movie.MaxSample + 1)
+	{
+		uint32	start = Movie.BytesPerSample * Movie.FlushedSamples;
+
+		fseek(Movie.File, Movie.ControllerDataOffset + start, SEEK_SET);
+		if (!fwrite(Movie.InputBuffer + start, 1, Movie.BytesPerSample * (Movie.MaxSample + 1) - start, Movie.File))
+			printf ("Movie flush failed.\n");
+
+		Movie.FlushedSamples = Movie.MaxSample + 1;
+	}
+
+	fseek(Movie.File, pos, SEEK_SET);
 }
 
 static void truncate_movie (void)
@@ -495,6 +549,7 @@ static void change_state (MovieState new_state)
 		truncate_movie();
 		fclose(Movie.File);
 		Movie.File = NULL;
+		close_keyframes();
 
 		if (S9xMoviePlaying() || S9xMovieRecording())
 			restore_previous_settings();
@@ -503,6 +558,270 @@ static void change_state (MovieState new_state)
 	Movie.State = new_state;
 }
 
+// Keyframe sidecar: "<movie>.smk" holds a header (magic, movie id, interval)
+// followed by appended entries (frame, sample, state size, data size) each
+// with a compressed savestate. A later entry replaces all entries at or past
+// its frame; a rerecord also truncates the file after the entries it keeps.
+
+static void open_keyframes (void)
+{
+	char	drive[_MAX_DRIVE + 1], dir[_MAX_DIR + 1], fname[_MAX_FNAME + 1], ext[_MAX_EXT + 1];
+	char	path[PATH_MAX + 1];
+	uint8	buf[SMK_HEADER_SIZE], *ptr;
+
+	close_keyframes();
+
+	if (Settings.MovieKeyframeInterval <= 0)
+		return;
+
+	_splitpath(Movie.Filename, drive, dir, fname, ext);
+	_makepath(path, drive, dir, fname, "smk");
+
+	Movie.KeyInterval = Settings.MovieKeyframeInterval;
+
+	if ((Movie.KeyFile = fopen(path, "rb+")))
+	{
+		ptr = buf;
+		if (fread(buf, 1, SMK_HEADER_SIZE, Movie.KeyFile) == SMK_HEADER_SIZE &&
+			Read32(ptr) == SMK_MAGIC && Read32(ptr) == Movie.MovieId && Read32(ptr) == Movie.KeyInterval)
+		{
+			struct SMovieKeyframe	key;
+			uint8					entry[SMK_ENTRY_SIZE];
+
+			while (fread(entry, 1, SMK_ENTRY_SIZE, Movie.KeyFile) == SMK_ENTRY_SIZE)
+			{
+				ptr = entry;
+				key.Frame     = Read32(ptr);
+				key.Sample    = Read32(ptr);
+				key.StateSize = Read32(ptr);
+				key.DataSize  = Read32(ptr);
+				key.Offset    = (uint32) ftell(Movie.KeyFile) - SMK_ENTRY_SIZE;
+
+				if (fseek(Movie.KeyFile, key.DataSize, SEEK_CUR))
+					break;
+
+				add_keyframe(&key);
+			}
+
+			return;
+		}
+
+		fclose(Movie.KeyFile);
+	}
+
+	// missing, stale or for another interval: start over
+	if (!(Movie.KeyFile = fopen(path, "wb+")))
+		return;
+
+	ptr = buf;
+	Write32(SMK_MAGIC, ptr);
+	Write32(Movie.MovieId, ptr);
+	Write32(Movie.KeyInterval, ptr);
+	fwrite(buf, 1, SMK_HEADER_SIZE, Movie.KeyFile);
+}
+
+static void close_keyframes (void)
+{
+	if (Movie.KeyFile)
+		fclose(Movie.KeyFile);
+
+	free(Movie.Keys);
+	Movie.KeyFile    = NULL;
+	Movie.Keys       = NULL;
+	Movie.NumKeys    = 0;
+	Movie.KeysSize   = 0;
+	Movie.KeyPending = FALSE;
+}
+
+static void add_keyframe (struct SMovieKeyframe *key)
+{
+	while (Movie.NumKeys && Movie.Keys[Movie.NumKeys - 1].Frame >= key->Frame)
+		Movie.NumKeys--;
+
+	if (Movie.NumKeys == Movie.KeysSize)
+	{
+		Movie.KeysSize = Movie.KeysSize ? Movie.KeysSize * 2 : 64;
+		Movie.Keys     = (struct SMovieKeyframe *) realloc(Movie.Keys, Movie.KeysSize * sizeof(struct SMovieKeyframe));
+	}
+
+	Movie.Keys[Movie.NumKeys++] = *key;
+}
+
+// Drops keyframes past frame or at/after sample and cuts them off the sidecar.
+static void trim_keyframes (uint32 frame, uint32 sample)
+{
+	uint32	n = Movie.NumKeys;
+
+	while (n && (Movie.Keys[n - 1].Frame > frame || Movie.Keys[n - 1].Sample >= sample))
+		n--;
+
+	if (n == Movie.NumKeys)
+		return;
+
+	Movie.NumKeys = n;
+
+	if (!Movie.KeyFile)
+		return;
+
+	// kept entries precede all dropped ones in the file
+	uint32	end = n ? Movie.Keys[n - 1].Offset + SMK_ENTRY_SIZE + Movie.Keys[n - 1].DataSize : SMK_HEADER_SIZE;
+
+	fflush(Movie.KeyFile);
+	if (ftruncate(fileno(Movie.KeyFile), end))
+		printf("Couldn't truncate movie keyframes.\n");
+}
+
+static void capture_keyframe (void)
+{
+	struct SMovieKeyframe	key;
+	MovieState				state = Movie.State;
+	bool8					screenshot = Settings.SnapshotScreenshots;
+	uint8					entry[SMK_ENTRY_SIZE], *ptr = entry;
+
+	if (!Movie.KeyFile)
+		return;
+
+	// while playing, only extend the index
+	if (state == MOVIE_STATE_PLAY && Movie.NumKeys && Movie.Keys[Movie.NumKeys - 1].Frame >= Movie.CurrentFrame)
+		return;
+
+	// keep the input log and screenshot out of the keyframe
+	Movie.State = MOVIE_STATE_NONE;
+	Settings.SnapshotScreenshots = FALSE;
+
+	key.StateSize = S9xFreezeSize();
+	uint8	*raw = new uint8[key.StateSize];
+	S9xFreezeGameMem(raw, key.StateSize);
+
+	Movie.State = state;
+	Settings.SnapshotScreenshots = screenshot;
+
+	uint8	*data = raw;
+	key.DataSize = key.StateSize;
+#ifdef ZLIB
+	uLongf	packed_size = compressBound(key.StateSize);
+	uint8	*packed = new uint8[packed_size];
+
+	if (compress2(packed, &packed_size, raw, key.StateSize, Z_BEST_SPEED) == Z_OK)
+	{
+		data = packed;
+		key.DataSize = (uint32) packed_size;
+	}
+#endif
+
+	key.Frame  = Movie.CurrentFrame;
+	key.Sample = Movie.CurrentSample;
+
+	fseek(Movie.KeyFile, 0, SEEK_END);
+	key.Offset = (uint32) ftell(Movie.KeyFile);
+
+	Write32(key.Frame, ptr);
+	Write32(key.Sample, ptr);
+	Write32(key.StateSize, ptr);
+	Write32(key.DataSize, ptr);
+
+	if (fwrite(entry, 1, SMK_ENTRY_SIZE, Movie.KeyFile) == SMK_ENTRY_SIZE &&
+		fwrite(data, 1, key.DataSize, Movie.KeyFile) == key.DataSize)
+		add_keyframe(&key);
+	else
+		printf("Couldn't write movie keyframe.\n");
+
+#ifdef ZLIB
+	delete[] packed;
+#endif
+	delete[] raw;
+}
+
+static bool8 restore_keyframe (struct SMovieKeyframe *key)
+{
+	uint8	*data = new uint8[key->DataSize];
+	uint8	*raw = data;
+	bool8	ok = FALSE;
+
+	if (!fseek(Movie.KeyFile, key->Offset + SMK_ENTRY_SIZE, SEEK_SET) &&
+		fread(data, 1, key->DataSize, Movie.KeyFile) == key->DataSize)
+	{
+		ok = TRUE;
+
+		if (key->DataSize != key->StateSize)
+		{
+		#ifdef ZLIB
+			uLongf	raw_size = key->StateSize;
+
+			raw = new uint8[key->StateSize];
+			ok = uncompress(raw, &raw_size, data, key->DataSize) == Z_OK && raw_size == key->StateSize;
+		#else
+			ok = FALSE;
+		#endif
+		}
+	}
+
+	if (ok)
+	{
+		MovieState	state = Movie.State;
+
+		Movie.State = MOVIE_STATE_NONE;
+		ok = S9xUnfreezeGameMem(raw, key->StateSize) == SUCCESS;
+		Movie.State = state;
+	}
+
+	if (ok)
+	{
+		Movie.CurrentFrame   = key->Frame;
+		Movie.CurrentSample  = key->Sample;
+		Movie.InputBufferPtr = Movie.InputBuffer + (Movie.BytesPerSample * Movie.CurrentSample);
+		read_frame_controller_data(true);
+	}
+
+	if (raw != data)
+		delete[] raw;
+	delete[] data;
+
+	return (ok);
+}
+
+void S9xMovieKeyframe (void)
+{
+	if (Movie.KeyPending)
+	{
+		Movie.KeyPending = FALSE;
+		capture_keyframe();
+	}
+}
+
+// Jumps to a frame of the movie being played back, starting from the closest
+// earlier keyframe unless playback is already closer.
+int S9xMovieSeek (uint32 frame)
+{
+	if (Movie.State != MOVIE_STATE_PLAY || frame > Movie.MaxFrame)
+		return (WRONG_FORMAT);
+
+	std::chrono::steady_clock::time_point	start = std::chrono::steady_clock::now();
+	uint32	emulated = 0;
+	int		k = (int) Movie.NumKeys - 1;
+
+	while (k >= 0 && Movie.Keys[k].Frame > frame)
+		k--;
+
+	if (frame < Movie.CurrentFrame || (k >= 0 && Movie.Keys[k].Frame > Movie.CurrentFrame))
+	{
+		if (k < 0 || !restore_keyframe(&Movie.Keys[k]))
+			return (FILE_NOT_FOUND);
+	}
+
+	while (Movie.State == MOVIE_STATE_PLAY && Movie.CurrentFrame < frame)
+	{
+		S9xRunFramesHeadless(1);
+		emulated++;
+	}
+
+	sprintf(String, "Seek to frame %u: %u frames emulated, %u ms.", frame, emulated,
+			(uint32) std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+	S9xMessage(S9X_INFO, S9X_MOVIE_INFO, String);
+
+	return (SUCCESS);
+}
+
 void S9xMovieFreeze (uint8 **buf, uint32 *size)
 {
 	if (!S9xMovieActive())
@@ -556,8 +875,22 @@ int S9xMovieUnfreeze (uint8 *buf, uint32 size)
 
 	if (!Movie.ReadOnly)
 	{
+		// Rerecords usually share a long prefix with what is already on disk.
+		uint32	old_space = Movie.BytesPerSample * (Movie.MaxSample + 1);
+		uint32	same = space_needed < old_space ? space_needed : old_space;
+		uint32	n = 0;
+
+		while (n < same && Movie.InputBuffer[n] == ptr[n])
+			n++;
+
+		if (Movie.FlushedSamples > n / Movie.BytesPerSample)
+			Movie.FlushedSamples = n / Movie.BytesPerSample;
+
 		change_state(MOVIE_STATE_RECORD);
 
+		// keyframes from the first changed sample on belong to the old input
+		trim_keyframes(current_frame, n / Movie.BytesPerSample);
+
 		Movie.CurrentFrame  = current_frame;
 		Movie.MaxFrame      = max_frame;
 		Movie.CurrentSample = current_sample;
@@ -673,6 +1006,8 @@ int S9xMovieOpen (const char *filename, bool8 read_only)
 		return (WRONG_FORMAT);
 	}
 
+	Movie.FlushedSamples = Movie.MaxSample + 1;
+
 	// read "baseline" controller data
 	if (Movie.MaxSample && Movie.MaxFrame)
 		read_frame_controller_data(true);
@@ -685,6 +1020,9 @@ int S9xMovieOpen (const char *filename, bool8 read_only)
 
 	change_state(MOVIE_STATE_PLAY);
 
+	open_keyframes();
+	capture_keyframe();
+
 	S9xUpdateFrameCounter(-1);
 
 	S9xMessage(S9X_INFO, S9X_MOVIE_INFO, MOVIE_INFO_REPLAY);
@@ -778,7 +1116,9 @@ int S9xMovieCreate (const char *filename, uint8 controllers_mask, uint8 opts, co
 	Movie.File           = fd;
 	Movie.BytesPerSample = bytes_per_sample();
 	Movie.InputBufferPtr = Movie.InputBuffer;
+	Movie.FlushedSamples = 0;
 	write_frame_controller_data();
+	write_sample(0);
 
 	Movie.CurrentFrame  = 0;
 	Movie.CurrentSample = 0;
@@ -788,6 +1128,9 @@ int S9xMovieCreate (const char *filename, uint8 controllers_mask, uint8 opts, co
 
 	change_state(MOVIE_STATE_RECORD);
 
+	open_keyframes();
+	capture_keyframe();
+
 	S9xUpdateFrameCounter(-1);
 
 	S9xMessage(S9X_INFO, S9X_MOVIE_INFO, MOVIE_INFO_RECORD);
@@ -885,6 +1228,9 @@ void S9xMovieUpdate (bool addFrame)
 				Movie.CurrentSample++;
 				if (addFrame)
 					Movie.CurrentFrame++;
+
+				if (addFrame && Movie.KeyInterval && Movie.CurrentFrame % Movie.KeyInterval == 0)
+					Movie.KeyPending = TRUE;
 			}
 
 			break;
@@ -903,8 +1249,10 @@ void S9xMovieUpdate (bool addFrame)
 			if (addFrame)
 				Movie.MaxFrame = ++Movie.CurrentFrame;
 
-			if (!fwrite((Movie.InputBufferPtr - Movie.BytesPerSample), 1, Movie.BytesPerSample, Movie.File))
-				printf ("Error writing control data.\n");
+			write_sample(Movie.CurrentSample);
+
+			if (addFrame && Movie.KeyInterval && Movie.CurrentFrame % Movie.KeyInterval == 0)
+				Movie.KeyPending = TRUE;
 
 			break;
 		}
@@ -929,8 +1277,7 @@ void S9xMovieUpdateOnReset (void)
 		Movie.MaxSample = ++Movie.CurrentSample;
 		Movie.MaxFrame = ++Movie.CurrentFrame;
 
-		if (!fwrite((Movie.InputBufferPtr - Movie.BytesPerSample), 1, Movie.BytesPerSample, Movie.File))
-			printf ("Failed writing reset data.\n");
+		write_sample(Movie.CurrentSample);
 	}
 }
 
@@ -1023,7 +1370,7 @@ void S9xMovieToggleFrameDisplay (void)
 
 void S9xUpdateFrameCounter (int offset)
 {
-	extern bool8	pad_read;
+	extern S9X_INSTANCE bool8	pad_read;
 
 	offset++;
 
@@ -58,6 +58,8 @@ void S9xMovieUpdateOnReset (void);
 void S9xUpdateFrameCounter (int o = 0);
 void S9xMovieFreeze (uint8 **, uint32 *);
 int S9xMovieUnfreeze (uint8 *, uint32);
+void S9xMovieKeyframe (void);
+int S9xMovieSeek (uint32);
 
 // accessor functions
 bool8 S9xMovieActive (void);
@@ -52,6 +52,7 @@
 #include "netplay.h"
 #include "snapshot.h"
 #include "display.h"
+#include "movie.h"
 
 void S9xNPClientLoop (void *);
 bool8 S9xNPLoadROM (uint32 len);
@@ -415,17 +416,21 @@ bool8 S9xNPWaitForHeartBeatDelay (uint32 time_msec)
     return TRUE;
 }
 
-bool8 S9xNPWaitForHeartBeat ()
+static void S9xNPRollbackRestart ();
+
+// Reads and handles one message from the server. Returns 1 for a heart-beat
+// (joypad) message, 0 for any other message and -1 after disconnecting.
+static int S9xNPReceiveServerMessage ()
 {
     uint8 header [3 + 4 + 4 * 5];
 
-    while (S9xNPGetData (NetPlay.Socket, header, 3 + 4))
+    if (S9xNPGetData (NetPlay.Socket, header, 3 + 4))
     {
         if (header [0] != NP_SERV_MAGIC)
         {
             S9xNPSetError ("Bad magic value from server while waiting for heart-beat message\n");
             S9xNPDisconnect ();
-            return (FALSE);
+            return (-1);
         }
         if (header [1] != NetPlay.ServerSequenceNum)
         {
@@ -448,7 +453,7 @@ bool8 S9xNPWaitForHeartBeat ()
                 {
                     S9xNPSetError ("Error while receiving 'JOYPAD' message.");
                     S9xNPDisconnect ();
-                    return (FALSE);
+                    return (-1);
                 }
             }
             NetPlay.Frame [NetPlay.JoypadWriteInd] = READ_LONG (&header [3]);
@@ -463,6 +468,9 @@ bool8 S9xNPWaitForHeartBeat ()
 
 			NetPlay.Paused = (header [2] & 0x20) != 0;
 
+            if (NetPlay.Rollback.Enabled)
+                S9xNPRollbackConfirm (NetPlay.Frame [NetPlay.JoypadWriteInd], NetPlay.Joypads [NetPlay.JoypadWriteInd], num);
+
             NetPlay.JoypadWriteInd = (NetPlay.JoypadWriteInd + 1) % NP_JOYPAD_HIST_SIZE;
 
             if (NetPlay.JoypadWriteInd != (NetPlay.JoypadReadInd + 1) % NP_JOYPAD_HIST_SIZE)
@@ -470,7 +478,7 @@ bool8 S9xNPWaitForHeartBeat ()
                 //printf ("(%d)", (NetPlay.JoypadWriteInd - NetPlay.JoypadReadInd) % NP_JOYPAD_HIST_SIZE); fflush (stdout);
             }
 //printf ("CLIENT: HB: @%d\n", S9xGetMilliTime () - START);
-            return (TRUE);
+            return (1);
         }
         else
         {
@@ -485,6 +493,7 @@ bool8 S9xNPWaitForHeartBeat ()
 		S9xReset ();
                 NetPlay.FrameCount = READ_LONG (&header [3]);
                 S9xNPResetJoypadReadPos ();
+                S9xNPRollbackRestart ();
                 S9xNPSendReady ();
                 break;
 	    case NP_SERV_PAUSE:
@@ -506,7 +515,10 @@ bool8 S9xNPWaitForHeartBeat ()
 #endif
                 S9xNPDiscardHeartbeats ();
                 if (S9xNPLoadROM (len - 7))
+                {
+                    S9xNPRollbackRestart ();
                     S9xNPSendReady (NP_CLNT_LOADED_ROM);
+                }
                 break;
             case NP_SERV_ROM_IMAGE:
 #ifdef NP_DEBUG
@@ -514,7 +526,10 @@ bool8 S9xNPWaitForHeartBeat ()
 #endif
                 S9xNPDiscardHeartbeats ();
                 if (S9xNPGetROMImage (len - 7))
+                {
+                    S9xNPRollbackRestart ();
                     S9xNPSendReady (NP_CLNT_RECEIVED_ROM_IMAGE);
+                }
                 break;
             case NP_SERV_SRAM_DATA:
 #ifdef NP_DEBUG
@@ -530,6 +545,7 @@ bool8 S9xNPWaitForHeartBeat ()
                 S9xNPDiscardHeartbeats ();
                 S9xNPGetFreezeFile (len - 7);
                 S9xNPResetJoypadReadPos ();
+                S9xNPRollbackRestart ();
                 S9xNPSendReady ();
                 break;
             default:
@@ -537,13 +553,25 @@ bool8 S9xNPWaitForHeartBeat ()
                 printf ("CLIENT: UNKNOWN received @%ld\n", S9xGetMilliTime () - START);
 #endif
                 S9xNPDisconnect ();
-                return (FALSE);
+                return (-1);
 	    }
 	}
+
+        return (0);
     }
 
     S9xNPDisconnect ();
-    return (FALSE);
+    return (-1);
+}
+
+bool8 S9xNPWaitForHeartBeat ()
+{
+    int res;
+
+    while ((res = S9xNPReceiveServerMessage ()) == 0)
+        ;
+
+    return (res > 0);
 }
 
 bool8 S9xNPLoadROMDialog (const char *rom_name)
@@ -1056,4 +1084,334 @@ void S9xNPSetWarning (const char *warning)
     Sleep (0);
 #endif
 }
+// Rollback mode
+
+#define NP_RB_SLOT(f) ((f) % NP_ROLLBACK_FRAMES)
+#define NP_RB_HIST(f) ((f) % NP_JOYPAD_HIST_SIZE)
+
+void S9xNPRollbackInit (uint32 frame)
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    S9xNPRollbackDeinit ();
+
+    rb->StateSize = S9xFreezeSize ();
+    for (int i = 0; i < NP_ROLLBACK_FRAMES; i++)
+        rb->States [i] = new uint8 [rb->StateSize];
+
+    rb->Frame = frame;
+    rb->ConfirmedFrame = frame;
+    rb->ReportedFrame = frame;
+    rb->RollbackFrom = ~0;
+    rb->Rollbacks = 0;
+    rb->ResimulatedFrames = 0;
+    memset (rb->Confirmed, 0, sizeof (rb->Confirmed));
+    memset (rb->LastJoypads, 0, sizeof (rb->LastJoypads));
+    rb->Enabled = TRUE;
+}
+
+// The server replaced the emulator state, so the saved states and inputs
+// no longer lead anywhere. Its first heart-beat after that is FrameCount + 1.
+static void S9xNPRollbackRestart ()
+{
+    if (NetPlay.Rollback.Enabled)
+        S9xNPRollbackInit (NetPlay.FrameCount + 1);
+}
+
+void S9xNPRollbackDeinit ()
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    for (int i = 0; i < NP_ROLLBACK_FRAMES; i++)
+    {
+        delete[] rb->States [i];
+        rb->States [i] = NULL;
+    }
+
+    rb->Enabled = FALSE;
+}
+
+// Cheap hash of the state that matters for a desync: RAM, VRAM and the
+// CPU registers. Two clients agreeing on it for a frame are in sync.
+uint32 S9xNPRollbackChecksum ()
+{
+    uint32 h = 2166136261u;
+    const uint32 *p;
+
+    p = (const uint32 *) Memory.RAM;
+    for (int i = 0; i < 0x20000 / 4; i++)
+        h = (h ^ p [i]) * 16777619u;
+
+    p = (const uint32 *) Memory.VRAM;
+    for (int i = 0; i < 0x10000 / 4; i++)
+        h = (h ^ p [i]) * 16777619u;
+
+    h = (h ^ Registers.PBPC) * 16777619u;
+    h = (h ^ (Registers.A.W | (Registers.X.W << 16))) * 16777619u;
+    h = (h ^ (Registers.Y.W | (Registers.S.W << 16))) * 16777619u;
+
+    return (h);
+}
+
+static void S9xNPRollbackSetJoypads (uint32 frame)
+{
+    for (int i = 0; i < NP_MAX_CLIENTS; i++)
+        MovieSetJoypad (i, NetPlay.Rollback.Joypads [NP_RB_HIST (frame)][i]);
+}
+
+static bool8 S9xNPRollbackSendChecksum (uint32 frame, uint32 checksum)
+{
+    uint8 data [7 + 4];
+    uint8 *ptr = data;
+
+    if (!NetPlay.Connected)
+        return (TRUE);
+
+    *ptr++ = NP_CLNT_MAGIC;
+    *ptr++ = NetPlay.MySequenceNum++;
+    *ptr++ = NP_CLNT_CHECKSUM;
+    WRITE_LONG (ptr, checksum);
+    ptr += 4;
+    WRITE_LONG (ptr, frame);
+
+    if (!S9xNPSendData (NetPlay.Socket, data, 7 + 4))
+    {
+        S9xNPSetError ("Error while sending frame checksum to server.");
+        S9xNPDisconnect ();
+        return (FALSE);
+    }
+
+    return (TRUE);
+}
+
+// Checksums are only meaningful once a frame was emulated with the server's
+// input, so report the frames that are both confirmed and correctly emulated.
+static void S9xNPRollbackReport ()
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    while (rb->ReportedFrame < rb->ConfirmedFrame && rb->ReportedFrame < rb->Frame &&
+           rb->ReportedFrame < rb->RollbackFrom)
+    {
+        if (!S9xNPRollbackSendChecksum (rb->ReportedFrame, rb->Checksums [NP_RB_SLOT (rb->ReportedFrame)]))
+            return;
+        rb->ReportedFrame++;
+    }
+}
+
+// Emulate one frame on the inputs recorded for it without any output,
+// keeping the state before it and the checksum after it.
+static void S9xNPRollbackStep (uint32 frame)
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    S9xFreezeGameMem (rb->States [NP_RB_SLOT (frame)], rb->StateSize);
+    S9xNPRollbackSetJoypads (frame);
+    S9xRunFramesHeadless (1);
+    rb->Checksums [NP_RB_SLOT (frame)] = S9xNPRollbackChecksum ();
+}
+
+static void S9xNPRollbackResimulate ()
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    if (rb->RollbackFrom >= rb->Frame)
+    {
+        rb->RollbackFrom = ~0;
+        return;
+    }
+
+    // The mispredicted frames were already shown and heard once.
+    S9xUnfreezeGameMem (rb->States [NP_RB_SLOT (rb->RollbackFrom)], rb->StateSize);
+    for (uint32 f = rb->RollbackFrom; f < rb->Frame; f++)
+    {
+        S9xNPRollbackStep (f);
+        rb->ResimulatedFrames++;
+    }
+
+    rb->Rollbacks++;
+    rb->RollbackFrom = ~0;
+}
+
+// Handles whatever the server has already sent without waiting for more,
+// so confirmed input is picked up as it arrives.
+static void S9xNPRollbackPoll ()
+{
+    while (NetPlay.Connected && S9xNPCheckForHeartBeat (0))
+    {
+        if (S9xNPReceiveServerMessage () < 0)
+            return;
+    }
+}
+
+// Called before emulating each frame instead of waiting for the server's
+// heart-beat. Returns FALSE when the client is too far ahead of the server
+// to predict any further; the caller should wait for input and retry.
+bool8 S9xNPRollbackBeginFrame (uint32 joypad)
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    S9xNPRollbackPoll ();
+    S9xNPRollbackResimulate ();
+
+    if (rb->Frame - rb->ConfirmedFrame >= NP_ROLLBACK_FRAMES)
+        return (FALSE);
+
+    uint32 *pads = rb->Joypads [NP_RB_HIST (rb->Frame)];
+
+    if (!rb->Confirmed [NP_RB_HIST (rb->Frame)])
+    {
+        memmove (pads, rb->LastJoypads, sizeof (rb->LastJoypads));
+        if (NetPlay.Player > 0 && NetPlay.Player <= NP_MAX_CLIENTS)
+            pads [NetPlay.Player - 1] = joypad | 0x80000000;
+    }
+
+    S9xFreezeGameMem (rb->States [NP_RB_SLOT (rb->Frame)], rb->StateSize);
+    S9xNPRollbackSetJoypads (rb->Frame);
+
+    return (TRUE);
+}
+
+void S9xNPRollbackEndFrame ()
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+
+    rb->Checksums [NP_RB_SLOT (rb->Frame)] = S9xNPRollbackChecksum ();
+    rb->Confirmed [NP_RB_HIST (rb->Frame + NP_JOYPAD_HIST_SIZE - NP_ROLLBACK_FRAMES)] = FALSE;
+    rb->Frame++;
+
+    S9xNPRollbackReport ();
+}
+
+// Server input for a frame has arrived. If that frame was already emulated
+// on a prediction that turned out wrong, schedule a rollback to it.
+void S9xNPRollbackConfirm (uint32 frame, const uint32 *joypads, int num)
+{
+    struct SNPRollback *rb = &NetPlay.Rollback;
+    uint32 pads [NP_MAX_CLIENTS];
+
+    if (frame < rb->ConfirmedFrame)
+        return;
+
+    if (frame != rb->ConfirmedFrame)
+        S9xNPSetWarning ("This Snes9x session may be out of sync with the server.");
+
+    if (frame >= rb->Frame + NP_JOYPAD_HIST_SIZE - NP_ROLLBACK_FRAMES)
+    {
+        S9xNPSetWarning ("Server input is too far ahead of this client.");
+        return;
+    }
+
+    memset (pads, 0, sizeof (pads));
+    memmove (pads, joypads, num * sizeof (uint32));
+
+    uint32 *slot = rb->Joypads [NP_RB_HIST (frame)];
+
+    if (frame < rb->Frame && memcmp (slot, pads, sizeof (pads)) && frame < rb->RollbackFrom)
+        rb->RollbackFrom = frame;
+
+    memmove (slot, pads, sizeof (pads));
+    memmove (rb->LastJoypads, pads, sizeof (pads));
+    rb->Confirmed [NP_RB_HIST (frame)] = TRUE;
+    rb->ConfirmedFrame = frame + 1;
+
+    S9xNPRollbackReport ();
+}
+
+// Plays the current game against itself with the remote player's input
+// delivered latency frames late, and checks every frame's checksum against
+// a lockstep run of the same input. The emulator state is restored after.
+bool8 S9xNPRollbackLoopbackTest (uint32 frames, uint32 latency)
+{
+    uint32 (*inputs) [2] = new uint32 [frames][2];
+    uint32 *reference = new uint32 [frames];
+    uint32 size = S9xFreezeSize ();
+    uint8 *start = new uint8 [size];
+    uint32 seed = 0x1234567;
+    uint32 mismatches = 0;
+    bool8 connected = NetPlay.Connected;
+    uint8 player = NetPlay.Player;
+    char buf [NP_MAX_ACTION_LEN];
+
+    if (latency >= NP_ROLLBACK_FRAMES)
+        latency = NP_ROLLBACK_FRAMES - 1;
+
+    // Inputs that hold for a few frames, like a player's would.
+    for (uint32 f = 0; f < frames; f++)
+    {
+        for (int p = 0; p < 2; p++)
+        {
+            if (f % 7 == 0 || !f)
+            {
+                seed = seed * 1103515245 + 12345;
+                inputs [f][p] = ((seed >> 16) & 0xfff0) | 0x80000000;
+            }
+            else
+                inputs [f][p] = inputs [f - 1][p];
+        }
+    }
+
+    S9xFreezeGameMem (start, size);
+
+    for (uint32 f = 0; f < frames; f++)
+    {
+        MovieSetJoypad (0, inputs [f][0]);
+        MovieSetJoypad (1, inputs [f][1]);
+        for (int i = 2; i < NP_MAX_CLIENTS; i++)
+            MovieSetJoypad (i, 0);
+        S9xRunFramesHeadless (1);
+        reference [f] = S9xNPRollbackChecksum ();
+    }
+
+    S9xUnfreezeGameMem (start, size);
+    NetPlay.Connected = FALSE;
+    NetPlay.Player = 1;
+
+    S9xNPRollbackInit (0);
+
+    struct SNPRollback *rb = &NetPlay.Rollback;
+    uint32 f = 0;
+
+    while (rb->ConfirmedFrame < frames)
+    {
+        if (f < frames && S9xNPRollbackBeginFrame (inputs [f][0]))
+        {
+            S9xRunFramesHeadless (1);
+            S9xNPRollbackEndFrame ();
+            f++;
+        }
+
+        // Deliver the server's input latency frames after it was due.
+        while (rb->ConfirmedFrame < frames && (rb->ConfirmedFrame + latency <= f || f == frames))
+        {
+            uint32 c = rb->ConfirmedFrame;
+            uint32 pads [2] = { inputs [c][0], inputs [c][1] };
+            uint32 reported = rb->ReportedFrame;
+
+            S9xNPRollbackConfirm (c, pads, 2);
+            S9xNPRollbackResimulate ();
+            S9xNPRollbackReport ();
+
+            for (uint32 g = reported; g < rb->ReportedFrame; g++)
+                if (rb->Checksums [NP_RB_SLOT (g)] != reference [g])
+                    mismatches++;
+        }
+    }
+
+    sprintf (buf, "Rollback loopback: %u frames, latency %u, %u rollbacks, %u resimulated, %u mismatches.",
+             frames, latency, rb->Rollbacks, rb->ResimulatedFrames, mismatches);
+    S9xNPSetAction (buf, TRUE);
+
+    S9xNPRollbackDeinit ();
+
+    S9xUnfreezeGameMem (start, size);
+    NetPlay.Connected = connected;
+    NetPlay.Player = player;
+
+    delete[] start;
+    delete[] reference;
+    delete[] inputs;
+
+    return (mismatches == 0);
+}
 #endif
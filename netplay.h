@@ -47,6 +47,7 @@
 #define NP_CLNT_LOADED_ROM 9
 #define NP_CLNT_RECEIVED_ROM_IMAGE 10
 #define NP_CLNT_WAITING_FOR_ROM_IMAGE 11
+#define NP_CLNT_CHECKSUM 12
 
 #define NP_SERV_HELLO 0
 #define NP_SERV_JOYPAD 1
@@ -109,10 +110,33 @@ struct SNPServer
     uint32 Paused;
     bool8  SendROMImageOnConnect;
     bool8  SyncByReset;
+    uint32 Checksums [NP_MAX_CLIENTS][NP_JOYPAD_HIST_SIZE];
+    uint32 ChecksumFrames [NP_MAX_CLIENTS][NP_JOYPAD_HIST_SIZE];
 };
 
 #define NP_MAX_ACTION_LEN 200
 
+// Rollback mode: the client runs ahead of the server on predicted input and
+// resimulates from a saved state when the server's input disagrees.
+#define NP_ROLLBACK_FRAMES 8
+
+struct SNPRollback
+{
+    bool8  Enabled;
+    uint32 Frame;           // next frame to be emulated
+    uint32 ConfirmedFrame;  // server input is known for every frame before this
+    uint32 RollbackFrom;    // earliest mispredicted frame, ~0 if none
+    uint32 ReportedFrame;   // checksums were sent for every frame before this
+    uint32 StateSize;
+    uint8  *States [NP_ROLLBACK_FRAMES];     // state before each frame
+    uint32 Checksums [NP_ROLLBACK_FRAMES];   // state checksum after each frame
+    uint32 Joypads [NP_JOYPAD_HIST_SIZE][NP_MAX_CLIENTS];
+    bool8  Confirmed [NP_JOYPAD_HIST_SIZE];
+    uint32 LastJoypads [NP_MAX_CLIENTS];     // latest server input, used as prediction
+    uint32 Rollbacks;
+    uint32 ResimulatedFrames;
+};
+
 struct SNetPlay
 {
     volatile uint8  MySequenceNum;
@@ -145,6 +169,7 @@ struct SNetPlay
     char   ActionMsg [NP_MAX_ACTION_LEN];
     char   ErrorMsg [NP_MAX_ACTION_LEN];
     char   WarningMsg [NP_MAX_ACTION_LEN];
+    struct SNPRollback Rollback;
 };
 
 extern "C" struct SNetPlay NetPlay;
@@ -198,6 +223,14 @@ void S9xNPServerQueueSendingLoadROMRequest (const char *filename);
 
 void S9xNPServerAddTask (uint32 task, void *data);
 
+void S9xNPRollbackInit (uint32 frame);
+void S9xNPRollbackDeinit ();
+bool8 S9xNPRollbackBeginFrame (uint32 joypad);
+void S9xNPRollbackEndFrame ();
+void S9xNPRollbackConfirm (uint32 frame, const uint32 *joypads, int num);
+uint32 S9xNPRollbackChecksum ();
+bool8 S9xNPRollbackLoopbackTest (uint32 frames, uint32 latency);
+
 bool8 S9xNPStartServer (int port);
 void S9xNPStopServer ();
 void S9xNPSendJoypadSwap ();
@@ -206,6 +206,17 @@ inline void sstrncpy(char *dst, const char *src, size_t size)
 #define SWAP_WORD(s)		(s) = (((s) & 0xff) <<  8) | (((s) & 0xff00) >> 8)
 #define SWAP_DWORD(s)		(s) = (((s) & 0xff) << 24) | (((s) & 0xff00) << 8) | (((s) & 0xff0000) >> 8) | (((s) & 0xff000000) >> 24)
 
+// Multi-instance builds. With S9X_THREAD_INSTANCES defined, all emulator
+// state is thread-local: every thread that sets up Settings, runs
+// Memory.Init(), S9xInitAPU() and S9xGraphicsInit() and loads a ROM owns an
+// independent emulator. Constant lookup tables stay shared between threads.
+// Thread-local access costs extra on some targets, so it is off by default.
+#ifdef S9X_THREAD_INSTANCES
+#define S9X_INSTANCE	thread_local
+#else
+#define S9X_INSTANCE
+#endif
+
 #include "pixform.h"
 
 #endif
@@ -22,7 +22,7 @@
 #include "missing.h"
 #endif
 
-extern uint8	*HDMAMemPointers[8];
+extern S9X_INSTANCE uint8	*HDMAMemPointers[8];
 
 
 static inline void S9xLatchCounters (bool force)
@@ -185,6 +185,27 @@ void S9xUpdateIRQPositions (bool initial)
 #endif
 }
 
+// Converted palettes for each brightness level. An entry is reused while no
+// CGRAM write has happened since it was built, so fades that only step
+// INIDISP copy a table instead of converting the palette again.
+struct SPaletteCacheEntry
+{
+	bool8	Valid;
+	uint32	Generation;
+	uint32	Red[256];
+	uint32	Green[256];
+	uint32	Blue[256];
+	uint16	ScreenColors[256];
+};
+
+static S9X_INSTANCE struct SPaletteCacheEntry	PaletteCache[16];
+
+void S9xResetPaletteCache (void)
+{
+	for (int b = 0; b < 16; b++)
+		PaletteCache[b].Valid = FALSE;
+}
+
 void S9xFixColourBrightness (void)
 {
 	IPPU.XB = mul_brightness[PPU.Brightness];
@@ -197,6 +218,17 @@ void S9xFixColourBrightness (void)
 			brightness_cap[i] = i;
 	}
 
+	struct SPaletteCacheEntry	*entry = &PaletteCache[PPU.Brightness];
+
+	if (entry->Valid && entry->Generation == IPPU.CGRAMGeneration)
+	{
+		memcpy(IPPU.Red,   entry->Red,   sizeof(IPPU.Red));
+		memcpy(IPPU.Green, entry->Green, sizeof(IPPU.Green));
+		memcpy(IPPU.Blue,  entry->Blue,  sizeof(IPPU.Blue));
+		memcpy(IPPU.ScreenColors, entry->ScreenColors, sizeof(IPPU.ScreenColors));
+		return;
+	}
+
 	for (int i = 0; i < 256; i++)
 	{
 		IPPU.Red[i]   = IPPU.XB[(PPU.CGDATA[i])       & 0x1f];
@@ -204,6 +236,13 @@ void S9xFixColourBrightness (void)
 		IPPU.Blue[i]  = IPPU.XB[(PPU.CGDATA[i] >> 10) & 0x1f];
 		IPPU.ScreenColors[i] = BUILD_PIXEL(IPPU.Red[i], IPPU.Green[i], IPPU.Blue[i]);
 	}
+
+	memcpy(entry->Red,   IPPU.Red,   sizeof(IPPU.Red));
+	memcpy(entry->Green, IPPU.Green, sizeof(IPPU.Green));
+	memcpy(entry->Blue,  IPPU.Blue,  sizeof(IPPU.Blue));
+	memcpy(entry->ScreenColors, IPPU.ScreenColors, sizeof(IPPU.ScreenColors));
+	entry->Generation = IPPU.CGRAMGeneration;
+	entry->Valid = TRUE;
 }
 
 void S9xSetPPU (uint8 Byte, uint16 Address)
@@ -957,7 +996,10 @@ void S9xSetPPU (uint8 Byte, uint16 Address)
 		if (Settings.SA1     && Address >= 0x2200)
 		{
 			if (Address <= 0x23ff)
+			{
+				S9xSA1Sync();
 				S9xSetSA1(Byte, Address);
+			}
 			else
 				Memory.FillRAM[Address] = Byte;
 			return;
@@ -1204,7 +1246,10 @@ uint8 S9xGetPPU (uint16 Address)
 			return (S9xGetSuperFX(Address));
 		else
 		if (Settings.SA1     && Address >= 0x2200)
+		{
+			S9xSA1Sync();
 			return (S9xGetSA1(Address));
+		}
 		else
 		if (Settings.BS      && Address >= 0x2188 && Address <= 0x219f)
 			return (S9xGetBSXPPU(Address));
@@ -1542,6 +1587,7 @@ void S9xSetCPU (uint8 Byte, uint16 Address)
 					}
 					else
 						CPU.FastROMSpeed = SLOW_ONE_CYCLE;
+					Memory.UpdateSpeedMap();
 					// we might currently be in FastROMSpeed region, S9xSetPCBase will update CPU.MemSpeed
 					S9xSetPCBase(Registers.PBPC);
 				}
@@ -1584,7 +1630,7 @@ uint8 S9xGetCPU (uint16 Address)
 	if (Address < 0x4200)
 	{
 	#ifdef SNES_JOY_READ_CALLBACKS
-		extern bool8 pad_read;
+		extern S9X_INSTANCE bool8 pad_read;
 		if (Address == 0x4016 || Address == 0x4017)
 		{
 			S9xOnSNESPadRead();
@@ -1701,7 +1747,7 @@ uint8 S9xGetCPU (uint16 Address)
 			case 0x421e: // JOY4L
 			case 0x421f: // JOY4H
 			#ifdef SNES_JOY_READ_CALLBACKS
-				extern bool8 pad_read;
+				extern S9X_INSTANCE bool8 pad_read;
 				if (Memory.FillRAM[0x4200] & 1)
 				{
 					S9xOnSNESPadRead();
@@ -1909,6 +1955,7 @@ void S9xSoftResetPPU (void)
 	IPPU.SkippedFrames = 0;
 	IPPU.FrameSkip = 0;
 
+	S9xResetPaletteCache();
 	S9xFixColourBrightness();
 	S9xBuildDirectColourMaps();
 
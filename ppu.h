@@ -39,6 +39,12 @@ struct InternalPPU
 	struct ClipData Clip[2][6];
 	bool8	ColorsChanged;
 	bool8	OBJChanged;
+	bool8	OBJEntriesChanged;	// only the sprites flagged in OBJDirty need updating
+	uint32	OBJDirty[4];
+	uint32	OBJFullSetups;
+	uint32	OBJPartialSetups;
+	uint32	SubScreenPixelsSkipped;		// subscreen pixels outside the math windows, this frame
+	uint32	SubScreenPixelsSkippedLast;	// the same for the previous frame
 	uint8	*TileCache[7];
 	uint8	*TileCached[7];
 	bool8	Interlace;
@@ -53,6 +59,7 @@ struct InternalPPU
 	uint32	Green[256];
 	uint32	Blue[256];
 	uint16	ScreenColors[256];
+	uint32	CGRAMGeneration;	// bumped on every CGRAM change, see S9xFixColourBrightness
 	uint8	MaxBrightness;
 	bool8	RenderThisFrame;
 	int		RenderedScreenWidth;
@@ -196,8 +203,8 @@ struct SPPU
 };
 
 extern uint16				SignExtend[2];
-extern struct SPPU			PPU;
-extern struct InternalPPU	IPPU;
+extern S9X_INSTANCE struct SPPU			PPU;
+extern S9X_INSTANCE struct InternalPPU	IPPU;
 
 void S9xResetPPU (void);
 void S9xResetPPUFast (void);
@@ -208,6 +215,7 @@ void S9xSetCPU (uint8, uint16);
 uint8 S9xGetCPU (uint16);
 void S9xUpdateIRQPositions (bool initial);
 void S9xFixColourBrightness (void);
+void S9xResetPaletteCache (void);
 void S9xDoAutoJoypad (void);
 
 #include "gfx.h"
@@ -220,7 +228,7 @@ typedef struct
 	uint8	_5A22;
 }	SnesModel;
 
-extern SnesModel	*Model;
+extern S9X_INSTANCE SnesModel	*Model;
 extern SnesModel	M1SNES;
 extern SnesModel	M2SNES;
 
@@ -263,7 +271,8 @@ static inline void REGISTER_2104 (uint8 Byte)
 		{
 			FLUSH_REDRAW();
 			PPU.OAMData[addr] = Byte;
-			IPPU.OBJChanged = TRUE;
+			IPPU.OBJEntriesChanged = TRUE;
+			IPPU.OBJDirty[(addr & 0x1f) >> 3] |= 0xf << (((addr & 0x1f) * 4) & 31);
 
 			// X position high bit, and sprite size (x4)
 			struct SOBJ *pObj = &PPU.OBJ[(addr & 0x1f) * 4];
@@ -291,7 +300,8 @@ static inline void REGISTER_2104 (uint8 Byte)
 			FLUSH_REDRAW();
 			PPU.OAMData[addr] = lowbyte;
 			PPU.OAMData[addr + 1] = highbyte;
-			IPPU.OBJChanged = TRUE;
+			IPPU.OBJEntriesChanged = TRUE;
+			IPPU.OBJDirty[(PPU.OAMAddr >> 1) >> 5] |= 1 << ((PPU.OAMAddr >> 1) & 31);
 			if (addr & 2)
 			{
 				// Tile
@@ -554,6 +564,7 @@ static inline void REGISTER_2122 (uint8 Byte)
 			FLUSH_REDRAW();
 			PPU.CGDATA[PPU.CGADD] = (Byte & 0x7f) << 8 | PPU.CGSavedByte;
 			IPPU.ColorsChanged = TRUE;
+			IPPU.CGRAMGeneration++;
 			IPPU.Red[PPU.CGADD] = IPPU.XB[PPU.CGSavedByte & 0x1f];
 			IPPU.Blue[PPU.CGADD] = IPPU.XB[(Byte >> 2) & 0x1f];
 			IPPU.Green[PPU.CGADD] = IPPU.XB[(PPU.CGDATA[PPU.CGADD] >> 5) & 0x1f];
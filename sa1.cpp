@@ -7,7 +7,7 @@
 #include "snes9x.h"
 #include "memmap.h"
 
-uint8	SA1OpenBus;
+S9X_INSTANCE uint8	SA1OpenBus;
 
 static void S9xSA1SetBWRAMMemMap (uint8);
 static void S9xSetSA1MemMap (uint32, uint8);
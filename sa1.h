@@ -38,6 +38,7 @@ struct SSA1
 
 	uint8	*Map[MEMMAP_NUM_BLOCKS];
 	uint8	*WriteMap[MEMMAP_NUM_BLOCKS];
+	uint8	*SharedMap[MEMMAP_NUM_BLOCKS];	// main CPU blocks remapped to MAP_SA1_SHARED
 	uint8	*BWRAM;
 
 	bool8	in_char_dma;
@@ -72,9 +73,9 @@ struct SSA1
 #define SA1ClearFlags(f)	(SA1Registers.P.W &= ~(f))
 #define SA1CheckFlag(f)		(SA1Registers.PL & (f))
 
-extern struct SSA1Registers	SA1Registers;
-extern struct SSA1			SA1;
-extern uint8				SA1OpenBus;
+extern S9X_INSTANCE struct SSA1Registers	SA1Registers;
+extern S9X_INSTANCE struct SSA1			SA1;
+extern S9X_INSTANCE uint8				SA1OpenBus;
 extern struct SOpcodes		S9xSA1OpcodesM1X1[256];
 extern struct SOpcodes		S9xSA1OpcodesM1X0[256];
 extern struct SOpcodes		S9xSA1OpcodesM0X1[256];
@@ -95,6 +96,15 @@ void S9xSA1Init (void);
 void S9xSA1MainLoop (void);
 void S9xSA1PostLoadState (void);
 
+// When Settings.SA1SyncQuantum is set, the SA-1 is allowed to fall behind the
+// main CPU by up to that many master cycles and is only caught up here, before
+// the main CPU touches I-RAM, BW-RAM, the SA-1 registers or starts a DMA.
+static inline void S9xSA1Sync (void)
+{
+	if (Settings.SA1 && Settings.SA1SyncQuantum)
+		S9xSA1MainLoop();
+}
+
 static inline void S9xSA1UnpackStatus (void)
 {
 	SA1._Zero = (SA1Registers.PL & Zero) == 0;
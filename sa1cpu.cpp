@@ -152,7 +152,8 @@ void S9xSA1MainLoop (void)
 			Opcodes = S9xOpcodesSlow;
 		}
 
-		if ((SA1Registers.PCw & MEMMAP_MASK) + SA1.S9xOpLengths[Op] >= MEMMAP_BLOCK_SIZE)
+		if ((SA1Registers.PCw & MEMMAP_MASK) >= MEMMAP_BLOCK_SIZE - MAX_OPCODE_LENGTH &&
+			(SA1Registers.PCw & MEMMAP_MASK) + SA1.S9xOpLengths[Op] >= MEMMAP_BLOCK_SIZE)
 		{
 			uint32	oldPC = SA1Registers.PBPC;
 			S9xSA1SetPCBase(SA1Registers.PBPC);
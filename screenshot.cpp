@@ -4,64 +4,245 @@
    For further information, consult the LICENSE file in the root directory.
 \*****************************************************************************/
 
-#ifdef HAVE_LIBPNG
-#include <png.h>
+#ifdef ZLIB
+#include <zlib.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #endif
+#include <string.h>
+#include <stdlib.h>
 #include "snes9x.h"
 #include "memmap.h"
 #include "display.h"
 #include "screenshot.h"
 
+#define SCREENSHOT_QUEUE_SIZE	4
 
-bool8 S9xDoScreenshot (int width, int height)
+static uint32	expand_hi[256], expand_lo[256];
+static bool		expand_ready = false;
+static int		burst_remaining = 0;
+
+// A native pixel splits into its high and low byte. Each colour field and
+// its 5-to-8 bit replication distribute over OR, so two 256-entry tables
+// yield the packed 0x00BBGGRR result with one lookup per byte.
+static void InitExpandTables (void)
 {
-	Settings.TakeScreenshot = FALSE;
+	for (int i = 0; i < 256; i++)
+	{
+		uint32	r, g, b;
 
-#ifdef HAVE_LIBPNG
-	FILE		*fp;
-	png_structp	png_ptr;
-	png_infop	info_ptr;
-	png_color_8	sig_bit;
-	int			imgwidth, imgheight;
-	const char	*fname;
+		DECOMPOSE_PIXEL(i << 8, r, g, b);
+		expand_hi[i] = ((r << 3) | (r >> 2)) | (((g << 3) | (g >> 2)) << 8) | (((b << 3) | (b >> 2)) << 16);
 
-	fname = S9xGetFilenameInc(".png", SCREENSHOT_DIR);
+		DECOMPOSE_PIXEL(i, r, g, b);
+		expand_lo[i] = ((r << 3) | (r >> 2)) | (((g << 3) | (g >> 2)) << 8) | (((b << 3) | (b >> 2)) << 16);
+	}
+
+	expand_ready = true;
+}
+
+void S9xExpandPixelRow (uint8 *out, const uint16 *src, int width, int step)
+{
+	if (!expand_ready)
+		InitExpandTables();
+
+	for (int x = 0; x < width; x++, src += step)
+	{
+		uint32	c = expand_hi[*src >> 8] | expand_lo[*src & 0xff];
+
+		*(out++) = c;
+		*(out++) = c >> 8;
+		*(out++) = c >> 16;
+	}
+}
+
+#ifdef ZLIB
+
+struct SScreenshotJob
+{
+	char				filename[PATH_MAX + 1];
+	int					width, height, level;
+	bool				reserved;	// an empty file holds the name until it is written
+	std::vector<uint8>	rgb;
+};
+
+static SScreenshotJob			jobs[SCREENSHOT_QUEUE_SIZE];
+static int						job_head = 0, job_count = 0;
+static std::mutex				job_lock;
+static std::condition_variable	job_cond;
+static bool						encoder_started = false, encoder_quit = false;
+static std::thread				encoder;
+
+// encoder thread scratch, kept between images
+static std::vector<uint8>	raw, zbuf;
+
+static void PutBE32 (uint8 *p, uint32 v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static bool WritePNGChunk (FILE *fp, const char *type, const uint8 *data, uint32 len)
+{
+	uint8	hdr[8], crc[4];
+	uLong	c = crc32(0, (const Bytef *) type, 4);
+
+	if (len)
+		c = crc32(c, data, len);
+	PutBE32(hdr, len);
+	memcpy(hdr + 4, type, 4);
+	PutBE32(crc, c);
+
+	return (fwrite(hdr, 1, 8, fp) == 8 && (!len || fwrite(data, 1, len, fp) == len) && fwrite(crc, 1, 4, fp) == 4);
+}
 
-	fp = fopen(fname, "wb");
+static bool EncodePNG (SScreenshotJob *job)
+{
+	static const uint8	signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	uint32	rowbytes = job->width * 3;
+	uint8	ihdr[13];
+
+	// every row is stored unfiltered
+	raw.resize((rowbytes + 1) * job->height);
+	for (int y = 0; y < job->height; y++)
+	{
+		raw[y * (rowbytes + 1)] = 0;
+		memcpy(&raw[y * (rowbytes + 1) + 1], &job->rgb[y * rowbytes], rowbytes);
+	}
+
+	uLongf	zlen = compressBound(raw.size());
+	zbuf.resize(zlen);
+	if (compress2(zbuf.data(), &zlen, raw.data(), raw.size(), job->level) != Z_OK)
+		return (false);
+
+	PutBE32(ihdr, job->width);
+	PutBE32(ihdr + 4, job->height);
+	ihdr[8]  = 8;	// bit depth
+	ihdr[9]  = 2;	// RGB
+	ihdr[10] = 0;
+	ihdr[11] = 0;
+	ihdr[12] = 0;
+
+	// write to a temporary name so readers never see a partial file
+	char	tmpname[PATH_MAX + 8];
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", job->filename);
+
+	FILE	*fp = fopen(tmpname, "wb");
 	if (!fp)
+		return (false);
+
+	bool	ok = fwrite(signature, 1, 8, fp) == 8 &&
+				 WritePNGChunk(fp, "IHDR", ihdr, 13) &&
+				 WritePNGChunk(fp, "IDAT", zbuf.data(), zlen) &&
+				 WritePNGChunk(fp, "IEND", NULL, 0);
+	ok = (fclose(fp) == 0) && ok;
+
+	if (!ok || rename(tmpname, job->filename) != 0)
 	{
-		S9xMessage(S9X_ERROR, 0, "Failed to take screenshot.");
-		return (FALSE);
+		remove(tmpname);
+		return (false);
 	}
 
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (!png_ptr)
+	return (true);
+}
+
+static void EncoderThread (void)
+{
+	std::unique_lock<std::mutex>	lock(job_lock);
+
+	for (;;)
 	{
-		fclose(fp);
-		remove(fname);
-		S9xMessage(S9X_ERROR, 0, "Failed to take screenshot.");
-		return (FALSE);
+		job_cond.wait(lock, [] { return job_count > 0 || encoder_quit; });
+		if (job_count == 0)
+			break;
+
+		// the head job stays owned by this thread until it is released below
+		SScreenshotJob	*job = &jobs[job_head];
+		lock.unlock();
+		if (!EncodePNG(job))
+		{
+			fprintf(stderr, "Failed to write %s.\n", job->filename);
+			if (job->reserved)
+				remove(job->filename);
+		}
+		lock.lock();
+
+		job_head = (job_head + 1) % SCREENSHOT_QUEUE_SIZE;
+		job_count--;
+		job_cond.notify_all();
 	}
+}
 
-	info_ptr = png_create_info_struct(png_ptr);
-	if (!info_ptr)
+// Drains the queue and stops the encoder before its mutex and thread are destroyed.
+static void StopEncoder (void)
+{
 	{
-		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
-		fclose(fp);
-		remove(fname);
-		S9xMessage(S9X_ERROR, 0, "Failed to take screenshot.");
-		return (FALSE);
+		std::lock_guard<std::mutex>	lock(job_lock);
+		encoder_quit = true;
+		job_cond.notify_all();
 	}
+	encoder.join();
+}
 
-	if (setjmp(png_jmpbuf(png_ptr)))
+static SScreenshotJob * AcquireJob (void)
+{
+	std::unique_lock<std::mutex>	lock(job_lock);
+
+	if (!encoder_started)
 	{
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		fclose(fp);
-		remove(fname);
-		S9xMessage(S9X_ERROR, 0, "Failed to take screenshot.");
-		return (FALSE);
+		encoder = std::thread(EncoderThread);
+		encoder_started = true;
+		atexit(StopEncoder);
 	}
 
+	job_cond.wait(lock, [] { return job_count < SCREENSHOT_QUEUE_SIZE; });
+	return (&jobs[(job_head + job_count) % SCREENSHOT_QUEUE_SIZE]);
+}
+
+static void SubmitJob (void)
+{
+	std::lock_guard<std::mutex>	lock(job_lock);
+
+	job_count++;
+	job_cond.notify_all();
+}
+
+bool8 S9xQueueScreenshot (const char *filename, const uint8 *rgb, int width, int height, int level)
+{
+	SScreenshotJob	*job = AcquireJob();
+
+	strncpy(job->filename, filename, PATH_MAX);
+	job->filename[PATH_MAX] = 0;
+	job->width  = width;
+	job->height = height;
+	job->level  = level;
+	job->reserved = false;
+	job->rgb.assign(rgb, rgb + width * height * 3);
+	SubmitJob();
+
+	return (TRUE);
+}
+
+void S9xFlushScreenshots (void)
+{
+	std::unique_lock<std::mutex>	lock(job_lock);
+
+	job_cond.wait(lock, [] { return job_count == 0; });
+}
+
+bool8 S9xDoScreenshot (int width, int height)
+{
+	if (burst_remaining > 0)
+		burst_remaining--;
+	Settings.TakeScreenshot = burst_remaining > 0;
+
+	int			imgwidth, imgheight;
+	const char	*fname;
+
 	imgwidth  = width;
 	imgheight = height;
 
@@ -79,66 +260,94 @@ bool8 S9xDoScreenshot (int width, int height)
 			imgheight = height << 1;
 	}
 
-	png_init_io(png_ptr, fp);
-
-	png_set_IHDR(png_ptr, info_ptr, imgwidth, imgheight, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-	sig_bit.red   = 5;
-	sig_bit.green = 5;
-	sig_bit.blue  = 5;
-	png_set_sBIT(png_ptr, info_ptr, &sig_bit);
-	png_set_shift(png_ptr, &sig_bit);
+	fname = S9xGetFilenameInc(".png", SCREENSHOT_DIR);
 
-	png_write_info(png_ptr, info_ptr);
+	// claim the name now, the next burst frame looks for a free one before this is written
+	FILE	*fp = fopen(fname, "wb");
+	if (!fp)
+	{
+		burst_remaining = 0;
+		Settings.TakeScreenshot = FALSE;
+		S9xMessage(S9X_ERROR, 0, "Failed to take screenshot.");
+		return (FALSE);
+	}
+	fclose(fp);
 
-	png_set_packing(png_ptr);
+	// converted straight into the queue slot, no intermediate copy
+	SScreenshotJob	*job = AcquireJob();
+	uint32			rowbytes = imgwidth * 3;
+	uint16			*screen = GFX.Screen;
 
-	png_byte	*row_pointer = new png_byte[png_get_rowbytes(png_ptr, info_ptr)];
-	uint16		*screen = GFX.Screen;
+	strncpy(job->filename, fname, PATH_MAX);
+	job->filename[PATH_MAX] = 0;
+	job->width  = imgwidth;
+	job->height = imgheight;
+	job->level  = Settings.ScreenshotCompression;
+	job->reserved = true;
+	job->rgb.resize(rowbytes * imgheight);
 
+	uint8	*row = job->rgb.data();
 	for (int y = 0; y < height; y++, screen += GFX.RealPPL)
 	{
-		png_byte	*rowpix = row_pointer;
+		S9xExpandPixelRow(row, screen, width, 1);
 
-		for (int x = 0; x < width; x++)
+		if (imgwidth != width)
 		{
-			uint32	r, g, b;
-
-			DECOMPOSE_PIXEL(screen[x], r, g, b);
-
-			*(rowpix++) = r;
-			*(rowpix++) = g;
-			*(rowpix++) = b;
-
-			if (imgwidth != width)
+			// double pixels in place, back to front
+			for (int x = width - 1; x >= 0; x--)
 			{
-				*(rowpix++) = r;
-				*(rowpix++) = g;
-				*(rowpix++) = b;
+				memmove(row + x * 6,     row + x * 3, 3);
+				memmove(row + x * 6 + 3, row + x * 3, 3);
 			}
 		}
 
-		png_write_row(png_ptr, row_pointer);
 		if (imgheight != height)
-			png_write_row(png_ptr, row_pointer);
-	}
-
-	delete [] row_pointer;
+		{
+			memcpy(row + rowbytes, row, rowbytes);
+			row += rowbytes;
+		}
 
-	png_write_end(png_ptr, info_ptr);
-	png_destroy_write_struct(&png_ptr, &info_ptr);
+		row += rowbytes;
+	}
 
-	fclose(fp);
+	SubmitJob();
 
-	fprintf(stderr, "%s saved.\n", fname);
+	fprintf(stderr, "%s queued.\n", fname);
 
 	const char	*base = S9xBasename(fname);
 	sprintf(String, "Saved screenshot %s", base);
 	S9xMessage(S9X_INFO, 0, String);
 
 	return (TRUE);
+}
+
 #else
-	fprintf(stderr, "Screenshot support not available (libpng was not found at build time).\n");
+
+bool8 S9xQueueScreenshot (const char *, const uint8 *, int, int, int)
+{
 	return (FALSE);
+}
+
+void S9xFlushScreenshots (void)
+{
+}
+
+bool8 S9xDoScreenshot (int width, int height)
+{
+	Settings.TakeScreenshot = FALSE;
+	burst_remaining = 0;
+
+	fprintf(stderr, "Screenshot support not available (zlib was not found at build time).\n");
+	return (FALSE);
+}
+
 #endif
+
+void S9xScreenshotBurst (int frames)
+{
+	if (frames <= 0)
+		return;
+
+	burst_remaining = frames;
+	Settings.TakeScreenshot = TRUE;
 }
@@ -8,5 +8,17 @@
 #define _SCREENSHOT_H_
 
 bool8 S9xDoScreenshot (int, int);
+#define SCREENSHOT_BURST_FRAMES	10
+
+// Capture the next N rendered frames.
+void S9xScreenshotBurst (int);
+
+// Expand a row of native pixels to 8-bit RGB, reading every step-th pixel.
+void S9xExpandPixelRow (uint8 *, const uint16 *, int, int);
+// Queue an 8-bit RGB image for PNG encoding in the background.
+// The pixels are copied, so the caller may reuse its buffer at once.
+bool8 S9xQueueScreenshot (const char *, const uint8 *, int, int, int);
+// Wait until every queued image has been written.
+void S9xFlushScreenshots (void);
 
 #endif
@@ -1,5 +1,7 @@
 #include "i18n.h"
 
+#include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <libintl.h>
 #include <libgen.h>
@@ -26,8 +28,10 @@ void I18n::init(const std::string &appname)
 {
 	// setenv("LC_MESSAGES", "zh_CN.UTF-8", 1);
 	setlocale(LC_ALL, "");
+	appname_ = appname;
 
 #if defined(WIN32)
+	localeDir_ = "locale";
 	bindtextdomain(appname.c_str(), "locale");
 	textdomain(appname.c_str());
 #else
@@ -37,6 +41,7 @@ void I18n::init(const std::string &appname)
 		char filepath[256];
 		const char *exedir = dirname(exepath);
 		sprintf(filepath, "%s/locale", exedir);
+		localeDir_ = filepath;
 		bindtextdomain(appname.c_str(), filepath);
 		bind_textdomain_codeset(appname.c_str(), "utf-8");
 		textdomain(appname.c_str());
@@ -67,4 +72,46 @@ void I18n::apply(const std::string &lang)
 	setenv("LC_MESSAGES", locale.c_str(), 1);
 #endif
 	setlocale(LC_ALL, "");
+	current_ = lang;
+}
+
+static inline uint32_t moRead32(const uint8_t *p, bool swap)
+{
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	return swap ? (v >> 24) | ((v >> 8) & 0xFF00) | ((v << 8) & 0xFF0000) | (v << 24) : v;
+}
+
+std::string I18n::catalogText() const
+{
+	std::string result;
+	if (current_.empty() || localeDir_.empty()) return result;
+	std::string path = localeDir_ + "/" + current_ + "/LC_MESSAGES/" + appname_ + ".mo";
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f == NULL) return result;
+	std::vector<uint8_t> mo;
+	uint8_t buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0) mo.insert(mo.end(), buf, buf + n);
+	fclose(f);
+
+	/* GNU .mo header: magic, revision, count, originals table, translations table */
+	if (mo.size() < 20) return result;
+	bool swap;
+	if (moRead32(&mo[0], false) == 0x950412DEu) swap = false;
+	else if (moRead32(&mo[0], true) == 0x950412DEu) swap = true;
+	else return result;
+	uint32_t count = moRead32(&mo[8], swap);
+	uint32_t table = moRead32(&mo[16], swap);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t ent = table + i * 8;
+		if (ent + 8 > mo.size()) break;
+		uint32_t len = moRead32(&mo[ent], swap);
+		uint32_t off = moRead32(&mo[ent + 4], swap);
+		if (off > mo.size() || len > mo.size() - off) continue;
+		result.append(reinterpret_cast<const char*>(&mo[off]), len);
+		result += '\n';
+	}
+	/* plural forms are NUL-separated */
+	for (auto &c: result) if (c == 0) c = '\n';
+	return result;
 }
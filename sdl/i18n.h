@@ -13,7 +13,13 @@ public:
 	void init(const std::string &appname);
 	void apply(const std::string &lang);
     inline const std::vector<Lang> &getList() { return languages_; }
+	/* All translated strings of the active catalog joined together,
+	 * empty if no translation is active */
+	std::string catalogText() const;
 
 private:
 	std::vector<Lang> languages_;
+	std::string appname_, localeDir_, current_;
 };
+
+extern I18n i18n;
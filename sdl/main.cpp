@@ -15,6 +15,11 @@
 #include "memmap.h"
 #include "controls.h"
 #include "snapshot.h"
+#include "screenshot.h"
+#include "statehash.h"
+#ifdef NETPLAY_SUPPORT
+#include "netplay.h"
+#endif
 
 #include <SDL.h>
 
@@ -45,10 +50,115 @@ static MenuResult enterCheatsMenu();
 I18n i18n;
 int languageIndex = 0;
 
+/* Instant resume: on quit the running game is frozen to <rom>.rsm next to
+ * the save states, together with a fingerprint of the ROM file in <rom>.rid.
+ * When the same unmodified file is launched again, its hashes are taken
+ * from the fingerprint instead of being recomputed and the state is restored
+ * before the first frame. */
+static bool instantResume = false;
+static bool resumeMatched = false;
+
+struct ResumeIdentity {
+    char magic[8];
+    uint32 fileSize;
+    int64 fileTime;
+    uint32 size;
+    uint32 checksum;
+    uint32 crc32;
+    unsigned char sha256[32];
+};
+
+static const char resumeMagic[8] = { 'S', '9', 'X', 'R', 'I', 'D', 1, 0 };
+
+static void buildResumeFilename(const char *rom, const char *ext, char filename[PATH_MAX + 1]) {
+    char drive[_MAX_DRIVE + 1], dir[_MAX_DIR + 1], def[_MAX_FNAME + 1], romext[_MAX_EXT + 1];
+
+    _splitpath(rom, drive, dir, def, romext);
+    snprintf(filename, PATH_MAX + 1, "%s%s%s.%s", S9xGetDirectory(SNAPSHOT_DIR), SLASH_STR, def, ext);
+}
+
+static void prepareResume(const char *rom) {
+    char filename[PATH_MAX + 1];
+    struct stat file_info;
+    ResumeIdentity id;
+
+    resumeMatched = false;
+    if (!instantResume || Settings.Multi || !rom[0] || stat(rom, &file_info))
+        return;
+
+    buildResumeFilename(rom, "rid", filename);
+    FILE *fp = fopen(filename, "rb");
+    if (!fp)
+        return;
+    bool ok = fread(&id, sizeof(id), 1, fp) == 1;
+    fclose(fp);
+
+    if (!ok || memcmp(id.magic, resumeMagic, 8) ||
+        id.fileSize != (uint32)file_info.st_size || id.fileTime != (int64)file_info.st_mtime)
+        return;
+
+    Memory.KnownIdentity.Valid = TRUE;
+    Memory.KnownIdentity.Size = id.size;
+    Memory.KnownIdentity.Checksum = id.checksum;
+    Memory.KnownIdentity.CRC32 = id.crc32;
+    memcpy(Memory.KnownIdentity.SHA256, id.sha256, 32);
+    resumeMatched = true;
+}
+
+static void resumeGame() {
+    char filename[PATH_MAX + 1];
+    struct stat file_info;
+
+    if (!resumeMatched)
+        return;
+
+    buildResumeFilename(Memory.ROMFilename, "rsm", filename);
+    if (stat(filename, &file_info))
+        return;
+
+    S9xUnfreezeGame(filename);
+    /* only resume once; a crash afterwards falls back to a cold boot */
+    remove(filename);
+}
+
+static void suspendGame() {
+    char filename[PATH_MAX + 1];
+    struct stat file_info;
+    ResumeIdentity id;
+
+    if (!instantResume || Settings.Multi || stat(Memory.ROMFilename, &file_info))
+        return;
+
+    buildResumeFilename(Memory.ROMFilename, "rsm", filename);
+    if (!S9xFreezeGame(filename))
+        return;
+
+    memset(&id, 0, sizeof(id));
+    memcpy(id.magic, resumeMagic, 8);
+    id.fileSize = file_info.st_size;
+    id.fileTime = file_info.st_mtime;
+    id.size = Memory.CalculatedSize;
+    id.checksum = Memory.CalculatedChecksum;
+    id.crc32 = Memory.ROMCRC32;
+    memcpy(id.sha256, Memory.ROMSHA256, 32);
+
+    buildResumeFilename(Memory.ROMFilename, "rid", filename);
+    FILE *fp = fopen(filename, "wb");
+    if (!fp)
+        return;
+    if (fwrite(&id, sizeof(id), 1, fp) != 1) {
+        fclose(fp);
+        remove(filename);
+        return;
+    }
+    fclose(fp);
+}
+
 int main(int argc, char *argv[]) {
     if (argc < 2)
         S9xUsage();
 
+    StartupTrace("start");
     i18n.init("snes9x");
 
     printf("\n\nSnes9x " VERSION " for unix\n");
@@ -83,10 +193,12 @@ int main(int argc, char *argv[]) {
     Settings.WrongMovieStateProtection = TRUE;
     Settings.DumpStreamsMaxFrames = -1;
     Settings.StretchScreenshots = 0;
+    Settings.ScreenshotCompression = 6;
     Settings.SnapshotScreenshots = FALSE;
     Settings.SkipFrames = AUTO_FRAMERATE;
     Settings.TurboSkipFrames = 15;
     Settings.FastSavestates = TRUE;
+    Settings.SnapshotCompression = 1;
     Settings.DontSaveOopsSnapshot = TRUE;
     Settings.AutoSaveDelay = 5;
     Settings.ApplyCheats = TRUE;
@@ -108,6 +220,7 @@ int main(int argc, char *argv[]) {
     if (romfn) strncpy(romFilename, romfn, PATH_MAX + 1);
 
     MakeS9xDirs();
+    StartupTrace("config");
 
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         fprintf(stderr, "Snes9x: Unable to initialize SDL.\nExiting...\n");
@@ -122,9 +235,11 @@ int main(int argc, char *argv[]) {
         SDL_Quit();
         exit(1);
     }
+    StartupTrace("memory/apu");
 
     S9xInitSound(128, 0);
     SoundPause();
+    StartupTrace("sound");
 
     bool startupWasMuted = Settings.Mute;
     SoundMute();
@@ -172,6 +287,7 @@ int main(int argc, char *argv[]) {
     }
     else if (romFilename)
     {
+        prepareResume(romFilename);
         loaded = Memory.LoadROM(romFilename);
 
         if (!loaded && romFilename[0])
@@ -197,6 +313,7 @@ int main(int argc, char *argv[]) {
         S9xExit();
         return 1;
     }
+    StartupTrace("rom");
 
     S9xDeleteCheats();
     S9xCheatsEnable();
@@ -212,19 +329,33 @@ int main(int argc, char *argv[]) {
     }
 
     S9xParseArgsForCheats(argv, argc);
+    StartupTrace("sram/cheats");
 
     CPU.Flags = saved_flags;
     Settings.StopEmulation = FALSE;
 
+#ifdef NETPLAY_SUPPORT
+    if (Settings.NetPlayLoopbackFrames) {
+        bool8 ok = S9xNPRollbackLoopbackTest(Settings.NetPlayLoopbackFrames, Settings.NetPlayLoopbackLatency);
+        printf("%s\n%s\n", NetPlay.ActionMsg, ok ? "PASS" : "FAIL");
+        exit(ok ? 0 : 1);
+    }
+#endif
+
     S9xInitInputDevices();
     S9xInitDisplay(argc, argv);
     S9xSetupDefaultKeymap();
     S9xTextMode();
+    StartupTrace("display");
 
-    if (snapshotFilename[0] && !S9xUnfreezeGame(snapshotFilename)) {
-        S9xExit();
-        return 1;
-    }
+    if (snapshotFilename[0]) {
+        if (!S9xUnfreezeGame(snapshotFilename)) {
+            S9xExit();
+            return 1;
+        }
+    } else
+        resumeGame();
+    StartupTrace("state");
 
     S9xGraphicsMode();
 
@@ -237,12 +368,17 @@ int main(int argc, char *argv[]) {
         SoundUnmute();
     SoundResume();
 
+    bool firstFrame = true;
     s9xTerm = false;
     while (!s9xTerm)
     {
         if (!Settings.Paused)
         {
             S9xMainLoop();
+            if (firstFrame) {
+                StartupTrace("first frame");
+                firstFrame = false;
+            }
         }
 
         if (Settings.Paused)
@@ -258,6 +394,8 @@ int main(int argc, char *argv[]) {
         S9xProcessEvents(FALSE);
     }
 
+    suspendGame();
+
 	const auto &l = i18n.getList();
     global_conf.SetString("Core::Language", languageIndex < l.size() ? l[languageIndex].locale.c_str() : "");
     if (VideoSettings.FrameRate == 0)
@@ -266,6 +404,8 @@ int main(int argc, char *argv[]) {
         global_conf.SetInt("Settings::FrameSkip", VideoSettings.FrameRate - 1);
     global_conf.SetBool("Display::DisplayFrameRate", Settings.DisplayFrameRate);
     global_conf.SetBool("Video::Fullscreen", VideoSettings.Fullscreen);
+    global_conf.SetBool("Video::Offscreen", VideoSettings.Offscreen);
+    global_conf.SetBool("Core::InstantResume", instantResume);
     global_conf.SetBool("Sound::Mute", Settings.Mute);
     global_conf.SetBool("Hack::AllowInvalidVRAMAccess", VideoSettings.AllowInvalidVRAMAccess);
     global_conf.SaveTo(saveFilename);
@@ -292,7 +432,7 @@ void S9xExit() {
     SoundClose();
     SDL_Quit();
 
-    exit(0);
+    exit(S9xStateHashFailed() ? 1 : 0);
 }
 
 void S9xExtraUsage(void) {
@@ -314,6 +454,8 @@ void S9xParsePortConfig(ConfigFile &conf, int pass) {
     global_conf.LoadFile(saveFilename);
 
     VideoSettings.Fullscreen = conf.GetBool("Video::Fullscreen", true);
+    VideoSettings.Offscreen = conf.GetBool("Video::Offscreen", false);
+    instantResume = conf.GetBool("Core::InstantResume", false);
     VideoSettings.AllowInvalidVRAMAccess = !Settings.BlockInvalidVRAMAccessMaster;
     VideoSettings.FrameRate = Settings.SkipFrames == AUTO_FRAMERATE ? 0 : Settings.SkipFrames;
     const char *language = conf.GetString("Core::Language", "");
@@ -336,7 +478,7 @@ void S9xParsePortConfig(ConfigFile &conf, int pass) {
 }
 
 void S9xAutoSaveSRAM() {
-    Memory.SaveSRAM(S9xGetFilename(".srm", SRAM_DIR));
+    Memory.AutoSaveSRAM(S9xGetFilename(".srm", SRAM_DIR));
 }
 
 void S9xProcessEvents (bool8) {
@@ -408,6 +550,7 @@ void S9xProcessEvents (bool8) {
         SoundPause(true);
         VideoFreeze();
         VideoSetOriginResolution();
+        VideoLoadMenuAssets();
 
         int index = 0;
         while ((index = enterMainMenu(index)) >= 0) ;
@@ -431,6 +574,34 @@ static void buildStateFilename(int n, char def[_MAX_FNAME + 1], char filename[PA
     snprintf(filename, PATH_MAX + 1, "%s%s%s.%03d", S9xGetDirectory(SNAPSHOT_DIR), SLASH_STR, def, n);
 }
 
+/* Decoded save-slot screenshots for the load-state menu, filled in the first
+ * time a slot is selected and dropped again when that slot is overwritten */
+#define STATE_SLOTS 11
+static VideoImageData slotThumbs[STATE_SLOTS];
+static bool slotThumbsLoaded[STATE_SLOTS];
+
+static void invalidateSlotThumb(int n) {
+    if (n < 0 || n >= STATE_SLOTS) return;
+    if (slotThumbs[n].buffer) VideoFreeImage(&slotThumbs[n]);
+    slotThumbs[n] = VideoImageData { NULL };
+    slotThumbsLoaded[n] = false;
+}
+
+static VideoImageData *getSlotThumb(int n) {
+    if (n < 0 || n >= STATE_SLOTS) return NULL;
+    if (!slotThumbsLoaded[n]) {
+        char filename[PATH_MAX + 1];
+        char def[_MAX_FNAME + 1];
+        buildStateFilename(n, def, filename);
+        strncat(filename, ".png", PATH_MAX);
+        /* the slot's screenshot may still be queued for writing */
+        S9xFlushScreenshots();
+        slotThumbs[n] = VideoLoadImageFile(filename);
+        slotThumbsLoaded[n] = true;
+    }
+    return slotThumbs[n].buffer ? &slotThumbs[n] : NULL;
+}
+
 static void quickLoadState(int n) {
     char filename[PATH_MAX + 1];
     char def[_MAX_FNAME + 1];
@@ -452,6 +623,7 @@ static void quickSaveState(int n) {
     if (S9xFreezeGame(filename)) {
         strncat(filename, ".png", PATH_MAX);
         VideoTakeScreenshot(filename);
+        invalidateSlotThumb(n);
         char buf[256];
         snprintf(buf, 256, "%s.%03d saved", def, n);
         S9xSetInfoString(buf);
@@ -531,16 +703,8 @@ static MenuResult enterLoadStateMenu() {
             };
             items[i].drawFunc = [](const MenuItem *item, int, bool selected) {
                 if (!selected) return;
-                int n = (int)(uintptr_t)item->customData;
-                char filename[PATH_MAX + 1];
-                char drive[_MAX_DRIVE + 1], dir[_MAX_DIR + 1], def[_MAX_FNAME + 1], ext[_MAX_EXT + 1];
-                _splitpath(Memory.ROMFilename, drive, dir, def, ext);
-                snprintf(filename, PATH_MAX + 1, "%s%s%s.%03d.png", S9xGetDirectory(SNAPSHOT_DIR), SLASH_STR, def, n);
-                VideoImageData vid = VideoLoadImageFile(filename);
-                if (vid.buffer) {
-                    VideoDrawImage(180, 64, &vid);
-                    VideoFreeImage(&vid);
-                }
+                VideoImageData *vid = getSlotThumb((int)(uintptr_t)item->customData);
+                if (vid) VideoDrawImage(180, 64, vid);
             };
         }
         items[i].text = text[i];
@@ -554,6 +718,8 @@ static MenuResult enterSettingsMenu() {
     const MenuItem items[] = {
         { MIT_BOOL, &Settings.Mute, _("Mute Audio") },
         { MIT_BOOL, &VideoSettings.Fullscreen, _("Fullscreen") },
+        { MIT_BOOL, &VideoSettings.Offscreen, _("Offscreen Render") },
+        { MIT_BOOL, &instantResume, _("Instant Resume") },
         { MIT_BOOL8, &Settings.DisplayFrameRate, _("Show FPS") },
         { MIT_INT32, &VideoSettings.FrameRate, _("Frame Skip"), 0, 10,
           [](const MenuItem*)->MenuResult { Settings.SkipFrames = VideoSettings.FrameRate == 0 ? AUTO_FRAMERATE : VideoSettings.FrameRate; return MR_NONE; },
@@ -26,25 +26,33 @@ enum MenuAction :uint32_t {
     MA_LAST     = 1 << 8,
     MA_PAGEUP   = 1 << 9,
     MA_PAGEDOWN = 1 << 10,
+
+    MA_REPEATABLE = MA_UP | MA_DOWN | MA_PAGEUP | MA_PAGEDOWN,
 };
 
 static void (*preDrawFunc)() = NULL;
 
 static MenuAction mapAction(SDLKey);
+static uint32_t heldActions();
 static void drawMenu(const MenuItem items[], int x, int valx, int y, int index, int topIndex, int count);
 
 void MenuSetPreDrawFunc(void (*func)()) {
     preDrawFunc = func;
 }
 
+/* key-repeat timing for held keys, in milliseconds */
+#define MENU_REPEAT_DELAY    300
+#define MENU_REPEAT_INTERVAL 80
+
 #define FIX_INDEX if (topIndex + pageCount <= index) topIndex = index - pageCount + 1; \
     else if (topIndex > index) topIndex = index
-#define CALL_TRIGGER changed = true; if (cur->triggerFunc && (mr = (*cur->triggerFunc)(cur)) != 0) { \
+/* a trigger may run a submenu that eats key-ups, so re-read what is still held */
+#define CALL_TRIGGER changed = true; if (cur->triggerFunc) { mr = (*cur->triggerFunc)(cur); held = heldActions(); \
     if (mr < 0) return mr; if (mr == MR_OK) return index; }
 int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int index) {
     int count = 0, topIndex = 0;
     const MenuItem *cur = items;
-    uint32_t actions = 0;
+    uint32_t actions = 0, held = 0;
     MenuResult mr;
     bool changed = true;
     while (cur->type != MIT_END) {
@@ -55,31 +63,42 @@ int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int i
     FIX_INDEX;
     cur = items + index;
     SDL_Event event;
+    /* Block until the next key instead of sleeping between polls: held
+     * direction keys are turned into repeated SDL_KEYDOWN events by SDL's
+     * own key-repeat timer, so every event is handled as soon as it arrives */
+    int oldDelay, oldInterval;
+    SDL_GetKeyRepeat(&oldDelay, &oldInterval);
+    SDL_EnableKeyRepeat(MENU_REPEAT_DELAY, MENU_REPEAT_INTERVAL);
+    struct RepeatRestore {
+        int delay, interval;
+        ~RepeatRestore() { SDL_EnableKeyRepeat(delay, interval); }
+    } repeatRestore = { oldDelay, oldInterval };
+    /* keys still held from the parent menu must not repeat into this one */
+    held = heldActions();
     for (;;) {
         if (changed) {
             changed = false;
             drawMenu(items, x, valx, y, index, topIndex, pageCount);
-            usleep(150000);
-        } else {
-            usleep(50000);
         }
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    s9xTerm = true;
-                    return MR_LEAVE;
-                case SDL_KEYDOWN:
-                    actions |= mapAction(event.key.keysym.sym);
-                    break;
-                case SDL_KEYUP:
-                    actions &= ~mapAction(event.key.keysym.sym);
-                    break;
-                default: break;
-            }
+        actions = 0;
+        if (!SDL_WaitEvent(&event)) continue;
+        switch (event.type) {
+            case SDL_QUIT:
+                s9xTerm = true;
+                return MR_LEAVE;
+            case SDL_KEYDOWN:
+                actions = mapAction(event.key.keysym.sym);
+                /* only navigation keys auto-repeat */
+                if (held & actions & ~MA_REPEATABLE) actions = 0;
+                held |= actions;
+                break;
+            case SDL_KEYUP:
+                held &= ~mapAction(event.key.keysym.sym);
+                break;
+            default: break;
         }
         if (!actions) continue;
         if (actions & MA_OK) {
-            actions &= ~MA_OK;
             switch (cur->type) {
                 case MIT_BOOL:
                     if (!cur->value) break;
@@ -101,11 +120,9 @@ int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int i
             continue;
         }
         if (actions & MA_CANCEL) {
-            actions &= ~MA_CANCEL;
             return MR_CANCEL;
         }
         if (actions & MA_LEAVE) {
-            actions &= ~MA_LEAVE;
             return MR_LEAVE;
         }
         if (actions & MA_UP) {
@@ -157,7 +174,6 @@ int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int i
             continue;
         }
         if (actions & MA_LEFT) {
-            actions &= ~MA_LEFT;
             int32_t val;
             switch (cur->type) {
                 case MIT_BOOL:
@@ -203,7 +219,6 @@ int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int i
             continue;
         }
         if (actions & MA_RIGHT) {
-            actions &= ~MA_RIGHT;
             int32_t val;
             switch (cur->type) {
                 case MIT_BOOL:
@@ -251,6 +266,16 @@ int MenuRun(const MenuItem items[], int x, int valx, int y, int pageCount, int i
     }
 }
 
+static uint32_t heldActions() {
+    int numkeys;
+    Uint8 *keys = SDL_GetKeyState(&numkeys);
+    uint32_t held = 0;
+    for (int k = 0; k < numkeys; ++k) {
+        if (keys[k]) held |= mapAction((SDLKey)k);
+    }
+    return held;
+}
+
 static MenuAction mapAction(SDLKey key) {
     switch (key) {
 #ifdef GCW_ZERO
@@ -14,7 +14,9 @@
 
 #include <SDL.h>
 
+#include <algorithm>
 #include <climits>
+#include <cstring>
 
 namespace TTF {
 
@@ -46,6 +48,7 @@ Font::Font(int size, uint8_t mono_width, SDL_Surface *surface): fontSize_(size),
 Font::~Font() {
 	for (auto *&p: rpData_) delete p;
 	rpData_.clear();
+	for (auto *&p: fontPages_) delete p;
 	for (auto &p: fonts_) {
 #ifdef USE_STB_TRUETYPE
 		delete static_cast<stbtt_fontinfo *>(p.font);
@@ -163,99 +166,151 @@ static inline uint32_t utf8toucs4(const char *&text) {
     return 0;
 }
 
-void Font::render(SDL_Surface *surface, int x, int y, const char *text, bool allowWrap, bool shadow) {
-    int stride = surface->pitch / surface->format->BytesPerPixel;
-    int surface_w = surface->w;
-
-    while (*text != 0) {
-        uint32_t ch = utf8toucs4(text);
-        if (ch == 0 || ch > 0xFFFFu) continue;
-
-        /* Check if bitmap is already cached */
-        FontData *fd;
-        auto ite = fontCache_.find(ch);
-
-        if (ite == fontCache_.end()) {
-	        FontInfo *fi = NULL;
+bool Font::rasterize(uint16_t ch, FontData *fd) {
+    FontInfo *fi = NULL;
 #ifdef USE_STB_TRUETYPE
-	        stbtt_fontinfo *info;
+    stbtt_fontinfo *info;
 #endif
-	        uint32_t index = 0;
-	        for (auto &f: fonts_) {
-	        	fi = &f;
+    uint32_t index = 0;
+    for (auto &f: fonts_) {
+        fi = &f;
 #ifdef USE_STB_TRUETYPE
-		        info = static_cast<stbtt_fontinfo*>(f.font);
-		        index = stbtt_FindGlyphIndex(info, ch);
-		        if (index == 0) continue;
+        info = static_cast<stbtt_fontinfo*>(f.font);
+        index = stbtt_FindGlyphIndex(info, ch);
+        if (index == 0) continue;
 #else
-		        index = FT_Get_Char_Index(f.face, ch);
-		        if (index == 0) continue;
-		        if (!FT_Load_Glyph(f.face, index, FT_LOAD_DEFAULT)) break;
+        index = FT_Get_Char_Index(f.face, ch);
+        if (index == 0) continue;
+        if (!FT_Load_Glyph(f.face, index, FT_LOAD_DEFAULT)) break;
 #endif
-	        }
-            fd = &fontCache_[ch];
-	        if (fi == NULL) {
-	            memset(fd, 0, sizeof(FontData));
-	            continue;
-	        }
+    }
+    if (fi == NULL) return false;
 
 #ifdef USE_STB_TRUETYPE
-            /* Read font data to cache */
-            int advW, leftB;
-            stbtt_GetGlyphHMetrics(info, index, &advW, &leftB);
-            fd->advW = static_cast<uint8_t>(fi->fontScale * advW);
-            leftB = static_cast<uint8_t>(fi->fontScale * leftB);
-            int ix0, iy0, ix1, iy1;
-            stbtt_GetGlyphBitmapBoxSubpixel(info, index, fi->fontScale, fi->fontScale, 3, 3, &ix0, &iy0, &ix1, &iy1);
-            fd->ix0 = leftB;
-            fd->iy0 = iy0;
-            fd->w = ix1 - ix0;
-            fd->h = iy1 - iy0;
+    /* Read font data to cache */
+    int advW, leftB;
+    stbtt_GetGlyphHMetrics(info, index, &advW, &leftB);
+    fd->advW = static_cast<uint8_t>(fi->fontScale * advW);
+    leftB = static_cast<uint8_t>(fi->fontScale * leftB);
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, index, fi->fontScale, fi->fontScale, 3, 3, &ix0, &iy0, &ix1, &iy1);
+    fd->ix0 = leftB;
+    fd->iy0 = iy0;
+    fd->w = ix1 - ix0;
+    fd->h = iy1 - iy0;
 #else
-            unsigned char *src_ptr;
-            int bitmap_pitch;
-            if (FT_Render_Glyph(fi->face->glyph, FT_RENDER_MODE_NORMAL)) break;
-            FT_GlyphSlot slot = fi->face->glyph;
-            fd->ix0 = slot->bitmap_left;
-            fd->iy0 = -slot->bitmap_top;
-            fd->w = slot->bitmap.width;
-            fd->h = slot->bitmap.rows;
-            fd->advW = slot->advance.x >> 6;
-            src_ptr = slot->bitmap.buffer;
-            bitmap_pitch = slot->bitmap.pitch;
+    unsigned char *src_ptr;
+    int bitmap_pitch;
+    if (FT_Render_Glyph(fi->face->glyph, FT_RENDER_MODE_NORMAL)) return false;
+    FT_GlyphSlot slot = fi->face->glyph;
+    fd->ix0 = slot->bitmap_left;
+    fd->iy0 = -slot->bitmap_top;
+    fd->w = slot->bitmap.width;
+    fd->h = slot->bitmap.rows;
+    fd->advW = slot->advance.x >> 6;
+    src_ptr = slot->bitmap.buffer;
+    bitmap_pitch = slot->bitmap.pitch;
 #endif
 
-            /* Get last rect pack bitmap */
-            auto rpidx = rpData_.size() - 1;
-            auto *rpd = rpData_[rpidx];
-            stbrp_rect rc = {0, fd->w, fd->h};
-            if (!stbrp_pack_rects(&rpd->context, &rc, 1)) {
-                /* No space to hold the bitmap,
-                 * create a new bitmap */
-                newRectPack();
-                rpidx = rpData_.size() - 1;
-                rpd = rpData_[rpidx];
-                stbrp_pack_rects(&rpd->context, &rc, 1);
-            }
-            /* Do rect pack */
-            fd->rpx = rc.x;
-            fd->rpy = rc.y;
-            fd->rpidx = rpidx;
+    /* Get last rect pack bitmap */
+    auto rpidx = rpData_.size() - 1;
+    auto *rpd = rpData_[rpidx];
+    stbrp_rect rc = {0, fd->w, fd->h};
+    if (!stbrp_pack_rects(&rpd->context, &rc, 1)) {
+        /* No space to hold the bitmap,
+         * create a new bitmap */
+        newRectPack();
+        rpidx = rpData_.size() - 1;
+        rpd = rpData_[rpidx];
+        stbrp_pack_rects(&rpd->context, &rc, 1);
+    }
+    /* Do rect pack */
+    fd->rpx = rc.x;
+    fd->rpy = rc.y;
+    fd->rpidx = rpidx;
 
 #ifdef USE_STB_TRUETYPE
-            stbtt_MakeGlyphBitmapSubpixel(info, &rpd->pixels[rc.y * RECTPACK_WIDTH + rc.x], fd->w, fd->h, RECTPACK_WIDTH, fi->fontScale, fi->fontScale, 3, 3, index);
+    stbtt_MakeGlyphBitmapSubpixel(info, &rpd->pixels[rc.y * RECTPACK_WIDTH + rc.x], fd->w, fd->h, RECTPACK_WIDTH, fi->fontScale, fi->fontScale, 3, 3, index);
+#else
+    auto *dst_ptr = &rpd->pixels[rc.y * RECTPACK_WIDTH + rc.x];
+    for (int k = 0; k < fd->h; ++k) {
+        memcpy(dst_ptr, src_ptr, fd->w);
+        src_ptr += bitmap_pitch;
+        dst_ptr += RECTPACK_WIDTH;
+    }
+#endif
+    return true;
+}
+
+Font::FontData *Font::getGlyph(uint16_t ch) {
+    FontPage *&page = fontPages_[ch >> 8];
+    if (page == nullptr) page = new FontPage {};
+    FontData *fd = &(*page)[ch & 0xFF];
+    if (!fd->cached) {
+        /* glyphs missing from all fonts stay cached with zero advance */
+        if (!rasterize(ch, fd)) memset(fd, 0, sizeof(FontData));
+        fd->cached = true;
+    }
+    return fd;
+}
+
+void Font::prewarm(const char *text) {
+    for (uint16_t ch = 0x20; ch < 0x7F; ++ch) getGlyph(ch);
+    while (*text != 0) {
+        uint32_t ch = utf8toucs4(text);
+        if (ch == 0 || ch > 0xFFFFu) continue;
+        getGlyph(ch);
+    }
+}
+
+/* Blit one glyph from the 8-bit atlas into a RGB565 surface */
+template<bool shadow>
+static inline void blitGlyph(uint16_t *__restrict__ outptr, int stride, const uint8_t *__restrict__ input,
+                             int w, int h, const uint16_t *__restrict__ depthColor) {
+    int iw = RECTPACK_WIDTH - w;
+    int ow = stride - w;
+    for (int j = h; j; j--) {
+        for (int i = w; i; i--) {
+#define TTF_NOALPHA
+#ifdef TTF_NOALPHA
+            uint8_t c;
+            if ((c = *input++) >= 32) {
+                *outptr = depthColor[c];
+                if (shadow)
+                    *(outptr + stride + 1) = 0;
+            }
+            ++outptr;
 #else
-            auto *dst_ptr = &rpd->pixels[rc.y * RECTPACK_WIDTH + rc.x];
-			for (int k = 0; k < fd->h; ++k) {
-				memcpy(dst_ptr, src_ptr, fd->w);
-				src_ptr += bitmap_pitch;
-				dst_ptr += RECTPACK_WIDTH;
-			}
+            uint16_t c = *outptr;
+            if (c == 0) { *outptr++ = depthColor[*input++]; continue; }
+            uint8_t n = *input++;
+#ifndef USE_BGR15
+            *outptr++ = ((((c >> 11u) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 11u)
+                | (((((c >> 5u) & 0x3Fu) * (0xFFu - n) + 0x3Fu * n) / 0xFFu) << 5u)
+                | (((c & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu);
+#else
+            *outptr++ = ((((c >> 10u) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 10u)
+                        | (((((c >> 5u) & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 5u)
+                        | (((c & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu);
+#endif
 #endif
-        } else {
-            fd = &ite->second;
-            if (fd->advW == 0) continue;
         }
+        outptr += ow;
+        input += iw;
+    }
+}
+
+void Font::render(SDL_Surface *surface, int x, int y, const char *text, bool allowWrap, bool shadow) {
+    int stride = surface->pitch / surface->format->BytesPerPixel;
+    int surface_w = surface->w;
+    uint16_t *pixels = static_cast<uint16_t*>(surface->pixels);
+
+    while (*text != 0) {
+        uint32_t ch = utf8toucs4(text);
+        if (ch == 0 || ch > 0xFFFFu) continue;
+
+        const FontData *fd = getGlyph(ch);
+        if (fd->advW == 0) continue;
         int cwidth = std::max(fd->advW, static_cast<uint8_t>((ch < (1u << 12u)) ? monoWidth_ : monoWidth_ * 2));
         if (x + cwidth > surface_w) {
             if (!allowWrap) break;
@@ -264,39 +319,12 @@ void Font::render(SDL_Surface *surface, int x, int y, const char *text, bool all
             if (y + fontSize_ > surface->h)
                 break;
         }
-        uint16_t *outptr = static_cast<uint16_t*>(surface->pixels) + stride * (y + fontSize_ + fd->iy0) + x + fd->ix0;
-        uint8_t *input = &rpData_[fd->rpidx]->pixels[fd->rpy * RECTPACK_WIDTH + fd->rpx];
-        int iw = RECTPACK_WIDTH - fd->w;
-        int ow = stride - fd->w;
-        for (int j = fd->h; j; j--) {
-            for (int i = fd->w; i; i--) {
-#define TTF_NOALPHA
-#ifdef TTF_NOALPHA
-                uint8_t c;
-                if ((c = *input++) >= 32) {
-                    *outptr++ = depthColor_[c];
-                    if (shadow)
-                        *(outptr + stride) = 0;
-                } else
-                    ++outptr;
-#else
-                uint16_t c = *outptr;
-                if (c == 0) { *outptr++ = depthColor_[*input++]; continue; }
-                uint8_t n = *input++;
-#ifndef USE_BGR15
-                *outptr++ = ((((c >> 11u) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 11u)
-                    | (((((c >> 5u) & 0x3Fu) * (0xFFu - n) + 0x3Fu * n) / 0xFFu) << 5u)
-                    | (((c & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu);
-#else
-	            *outptr++ = ((((c >> 10u) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 10u)
-	                        | (((((c >> 5u) & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu) << 5u)
-	                        | (((c & 0x1Fu) * (0xFFu - n) + 0x1Fu * n) / 0xFFu);
-#endif
-#endif
-            }
-            outptr += ow;
-            input += iw;
-        }
+        uint16_t *outptr = pixels + stride * (y + fontSize_ + fd->iy0) + x + fd->ix0;
+        const uint8_t *input = &rpData_[fd->rpidx]->pixels[fd->rpy * RECTPACK_WIDTH + fd->rpx];
+        if (shadow)
+            blitGlyph<true>(outptr, stride, input, fd->w, fd->h, depthColor_);
+        else
+            blitGlyph<false>(outptr, stride, input, fd->w, fd->h, depthColor_);
         x += cwidth;
     }
 }
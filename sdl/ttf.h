@@ -2,7 +2,6 @@
 
 #include <cstdint>
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include <array>
 
@@ -27,7 +26,11 @@ class Font {
         int8_t ix0, iy0;
         uint8_t w, h;
         uint8_t advW;
+        bool cached;
     };
+    /* glyph cache is a flat table of 256-entry codepoint pages,
+     * pages are allocated the first time one of their glyphs is used */
+    typedef std::array<FontData, 256> FontPage;
 	struct FontInfo {
 #ifdef USE_STB_TRUETYPE
 		float fontScale = 0.f;
@@ -43,17 +46,21 @@ public:
 	bool add(const std::string& filename, int index = 0);
 
     void render(SDL_Surface *surface, int x, int y, const char *text, bool allowWrap = false, bool shadow = false);
+    /* rasterize every glyph used by text into the atlas ahead of time */
+    void prewarm(const char *text);
 
 private:
     void newRectPack();
+    FontData *getGlyph(uint16_t ch);
+    bool rasterize(uint16_t ch, FontData *fd);
 
 private:
     std::string ttfFilename_;
     int fontSize_ = 0;
     std::vector<FontInfo> fonts_;
-    std::unordered_map<uint16_t, FontData> fontCache_;
+    std::array<FontPage*, 256> fontPages_ {};
     std::vector<RectPackData*> rpData_;
-    uint32_t depthColor_[256];
+    uint16_t depthColor_[256];
     uint8_t monoWidth_ = 0;
 
 #ifndef USE_STB_TRUETYPE
@@ -318,3 +318,22 @@ uint64_t GetTicks() {
     clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
     return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec / 1000U);
 }
+
+void StartupTrace(const char *phase) {
+    static int enabled = -1;
+    static uint64_t start, last;
+
+    if (enabled < 0) enabled = getenv("SNES9X_STARTUP_TRACE") != NULL;
+    if (!enabled) return;
+
+    /* the coarse clock used by GetTicks is too slow to tell phases apart */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec / 1000U);
+    if (!start) start = last = now;
+
+    fprintf(stderr, "startup: %-16s %5u.%03u ms (+%u.%03u)\n", phase,
+            (unsigned)((now - start) / 1000), (unsigned)((now - start) % 1000),
+            (unsigned)((now - last) / 1000), (unsigned)((now - last) % 1000));
+    last = now;
+}
@@ -5,3 +5,7 @@
 int MakeS9xDirs();
 
 uint64_t GetTicks();
+
+/* Print how long the startup phase that just finished took; only active when
+ * SNES9X_STARTUP_TRACE is set in the environment */
+void StartupTrace(const char *phase);
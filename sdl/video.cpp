@@ -1,5 +1,6 @@
 #include "video.h"
 #include "ttf.h"
+#include "i18n.h"
 #include "menu.h"
 #include "util.h"
 
@@ -7,6 +8,7 @@
 #include "snes9x.h"
 #include "gfx.h"
 #include "ppu.h"
+#include "screenshot.h"
 
 #include <SDL.h>
 #include <libintl.h>
@@ -21,8 +23,6 @@
 #define STBI_NO_PNM
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 
 static SDL_Surface *screen = NULL;
 static uint32 screenWidth = 0, screenHeight = 0;
@@ -40,8 +40,25 @@ static char logMsg[256] = {};
 static uint64_t logDeadline = 0ULL;
 static TTF::Font *ttf_font = NULL;
 static VideoImageData bg;
+static bool menuAssetsLoaded = false;
 static bool clearCache = false;
 
+/* Offscreen rendering: the PPU draws into a cached buffer and only lines
+ * whose hash changed since this back buffer was last filled are copied */
+#define OFFSCREEN_MAX_LINES 512
+#ifdef SDL_TRIPLEBUF
+#define OFFSCREEN_MAX_BUFFERS 3
+#else
+#define OFFSCREEN_MAX_BUFFERS 2
+#endif
+static uint16_t *offscreen = NULL;
+static size_t offscreenSize = 0;
+static bool renderingOffscreen = false;
+static uint16_t *osdBuffer = NULL;
+static uint32_t lineHash[OFFSCREEN_MAX_BUFFERS][OFFSCREEN_MAX_LINES];
+static bool lineHashValid[OFFSCREEN_MAX_BUFFERS];
+static int lineHashBuffer = 0;
+
 static bool freezed = false;
 static const int freezeWidth = SNES_WIDTH / 2, freezeHeight = SNES_HEIGHT / 2;
 static uint8_t freezeBuffer[freezeWidth * freezeHeight * 3];
@@ -68,20 +85,28 @@ void S9xInitDisplay(int argc, char **argv) {
     SDL_ShowCursor(0);
     VideoSetOriginResolution();
 
-	VideoFontInit();
-
     S9xGraphicsInit();
     // S9xCustomDisplayString = &VideoCustomDisplayString;
     MenuSetPreDrawFunc(&predrawMenu);
+}
 
+/* The TrueType font and the background are only drawn by the menu, so they
+ * are left out of startup and loaded the first time the menu opens */
+void VideoLoadMenuAssets() {
+    if (menuAssetsLoaded) return;
+    VideoFontInit();
     bg = VideoLoadImageFile("bg.png");
+    menuAssetsLoaded = true;
 }
 
 void S9xDeinitDisplay() {
-    VideoFreeImage(&bg);
+    if (menuAssetsLoaded) VideoFreeImage(&bg);
 
     S9xGraphicsDeinit();
     delete ttf_font;
+    delete[] offscreen;
+    offscreen = NULL;
+    offscreenSize = 0;
 }
 
 void S9xTextMode() {
@@ -98,13 +123,72 @@ bool8 S9xInitUpdate() {
     return 1;
 }
 
+static void invalidateLineHashes() {
+    for (int i = 0; i < OFFSCREEN_MAX_BUFFERS; ++i) lineHashValid[i] = false;
+}
+
+/* Point GFX.Screen at the offscreen buffer or straight at the surface */
+static void setRenderTarget() {
+    GFX.Pitch = screen->pitch;
+    renderingOffscreen = VideoSettings.Offscreen && screen->h <= OFFSCREEN_MAX_LINES;
+    if (!renderingOffscreen) {
+        GFX.Screen = (uint16*)screen->pixels + renderOffset;
+        return;
+    }
+    size_t size = screen->pitch * screen->h;
+    if (size != offscreenSize) {
+        delete[] offscreen;
+        offscreen = new uint16_t[size / 2];
+        offscreenSize = size;
+        memset(offscreen, 0, size);
+        invalidateLineHashes();
+    }
+    GFX.Screen = (uint16*)offscreen + renderOffset;
+}
+
+static inline uint32_t hashLine(const uint16_t *line, int width) {
+    const uint32_t *p = (const uint32_t*)line;
+    uint32_t h = 2166136261u;
+    for (int i = width >> 1; i; --i) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+/* Copy runs of changed lines to the back buffer */
+static void presentOffscreen() {
+    int buffers = (screen->flags & SDL_DOUBLEBUF) ? OFFSCREEN_MAX_BUFFERS : 1;
+    int pitch = screen->pitch / 2;
+    uint16_t *src = offscreen;
+    uint16_t *dst = (uint16_t*)screen->pixels;
+    uint32_t *hashes = lineHash[lineHashBuffer];
+    bool valid = lineHashValid[lineHashBuffer];
+    int runStart = -1;
+    for (int y = 0; y < screen->h; ++y) {
+        uint32_t h = hashLine(src + y * pitch, screen->w);
+        bool dirty = !valid || hashes[y] != h;
+        hashes[y] = h;
+        if (dirty) {
+            if (runStart < 0) runStart = y;
+        } else if (runStart >= 0) {
+            memcpy(dst + runStart * pitch, src + runStart * pitch, (y - runStart) * screen->pitch);
+            runStart = -1;
+        }
+    }
+    if (runStart >= 0)
+        memcpy(dst + runStart * pitch, src + runStart * pitch, (screen->h - runStart) * screen->pitch);
+    lineHashValid[lineHashBuffer] = true;
+    if (++lineHashBuffer >= buffers) lineHashBuffer = 0;
+}
+
 bool8 S9xDeinitUpdate(int width, int height) {
     if (logMsg[0]) {
+        if (renderingOffscreen) osdBuffer = offscreen;
         VideoOutputStringPixel(16, 16, logMsg, true, true);
+        osdBuffer = NULL;
         if (GetTicks() >= logDeadline) {
             logMsg[0] = 0;
         }
     }
+    if (renderingOffscreen) presentOffscreen();
     if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
     SDL_Flip(screen);
     if (VideoSettings.Fullscreen) {
@@ -127,10 +211,12 @@ bool8 S9xDeinitUpdate(int width, int height) {
         SDL_Flip(screen);
         VideoClear();
 #endif
-        GFX.Pitch = screen->pitch;
+        if (offscreen) memset(offscreen, 0, offscreenSize);
+        invalidateLineHashes();
+        lineHashBuffer = 0;
     }
     if (SDL_MUSTLOCK(screen)) SDL_LockSurface(screen);
-    GFX.Screen = (uint16*)screen->pixels + renderOffset;
+    setRenderTarget();
     return 1;
 }
 
@@ -227,7 +313,8 @@ void VideoFontInit() {
         }
         ttf_font->add(font_filename);
     }
-
+    /* rasterize the active translation's glyphs now rather than on first use mid-frame */
+    ttf_font->prewarm(i18n.catalogText().c_str());
 }
 
 void VideoSetOriginResolution() {
@@ -248,8 +335,8 @@ void VideoSetOriginResolution() {
     int w = (SNES_WIDTH + 7u) & ~7u;
     int h = (SNES_HEIGHT + 7u) & ~7u;
     renderOffset = (w < 320 ? (320 - w) / 2 : 0) + (h < 240 ? ((240 - h) / 2 * 320) : 0);
-    GFX.Screen = (uint16*)screen->pixels + renderOffset;
-    GFX.Pitch = screen->pitch;
+    invalidateLineHashes();
+    setRenderTarget();
 }
 
 void VideoOutputString(int x, int y, const char *text, bool allowWrap, bool shadow) {
@@ -393,7 +480,7 @@ void VideoOutputStringPixel(int x, int y, const char *text, bool allowWrap, bool
         int pos = 0;
         uint8_t c = *text++;
         if (c > 0x7F) continue;
-        uint16_t *ptr = (uint16_t *)screen->pixels + x + y*screenWidth;
+        uint16_t *ptr = (osdBuffer ? osdBuffer : (uint16_t *)screen->pixels) + x + y*screenWidth;
         const unsigned char *dataptr = font8x8data[c];
         for (int l = 0; l < 8; l++) {
             unsigned char data = *dataptr++;
@@ -470,6 +557,7 @@ void VideoFlip() {
     SDL_Flip(screen);
     if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
     GFX.Screen = (uint16*)screen->pixels;
+    renderingOffscreen = false;
 }
 
 void VideoFreeze() {
@@ -477,15 +565,8 @@ void VideoFreeze() {
     uint8_t *out = freezeBuffer;
     int pitch = screen->pitch;
     for (int j = freezeHeight; j; --j) {
-        uint16_t *inbuf = ptr;
-        for (int i = freezeWidth; i; --i) {
-            uint16_t c = *inbuf;
-            out[0] = (c >> 11) * 0xFF / 0x1F;
-            out[1] = ((c >> 5) & 0x3F) * 0xFF / 0x3F;
-            out[2] = (c & 0x1F) * 0xFF / 0x1F;
-            inbuf += 2;
-            out += 3;
-        }
+        S9xExpandPixelRow(out, ptr, freezeWidth, 2);
+        out += freezeWidth * 3;
         ptr += pitch;
     }
     freezed = true;
@@ -534,7 +615,7 @@ void VideoDrawImage(int x, int y, VideoImageData *data) {
 void VideoTakeScreenshot(const char *filename) {
     bool fr = freezed;
     if (!fr) VideoFreeze();
-    stbi_write_png(filename, freezeWidth, freezeHeight, STBI_rgb, freezeBuffer, 0);
+    S9xQueueScreenshot(filename, freezeBuffer, freezeWidth, freezeHeight, Settings.ScreenshotCompression);
     if (!fr) VideoUnfreeze();
 }
 
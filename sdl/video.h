@@ -9,11 +9,14 @@ struct VideoImageData {
 
 struct SVideoSettings {
     bool Fullscreen;
+    bool Offscreen;
     bool AllowInvalidVRAMAccess;
     uint32_t FrameRate;
 };
 
 void VideoFontInit();
+/* Load the font and background used only by the menu, once */
+void VideoLoadMenuAssets();
 void VideoSetOriginResolution();
 void VideoOutputString(int x, int y, const char *text, bool allowWrap = false, bool shadow = false);
 void VideoOutputStringPixel(int x, int y, const char *text, bool allowWrap = false, bool shadow = false);
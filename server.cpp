@@ -491,6 +491,35 @@ void S9xNPProcessClient (int c)
         case NP_CLNT_JOYPAD:
             NPServer.Joypads [c] = len;
             break;
+        case NP_CLNT_CHECKSUM:
+        {
+            uint8 frame_data [4];
+            uint32 frame;
+
+            if (!S9xNPSGetData (NPServer.Clients [c].Socket, frame_data, 4))
+            {
+                S9xNPSetWarning ("SERVER: Failed to get checksum from client.\n");
+                S9xNPShutdownClient (c, TRUE);
+                return;
+            }
+            frame = READ_LONG (frame_data);
+
+            NPServer.Checksums [c][frame % NP_JOYPAD_HIST_SIZE] = len;
+            NPServer.ChecksumFrames [c][frame % NP_JOYPAD_HIST_SIZE] = frame;
+
+            for (int d = 0; d < NP_MAX_CLIENTS; d++)
+            {
+                if (d != c && NPServer.Clients [d].Connected &&
+                    NPServer.ChecksumFrames [d][frame % NP_JOYPAD_HIST_SIZE] == frame &&
+                    NPServer.Checksums [d][frame % NP_JOYPAD_HIST_SIZE] != len)
+                {
+                    sprintf (NetPlay.WarningMsg, "SERVER: Clients %d and %d are out of sync at frame %u.", d + 1, c + 1, frame);
+                    S9xNPSetWarning (NetPlay.WarningMsg);
+                    break;
+                }
+            }
+            break;
+        }
         case NP_CLNT_PAUSE:
 #ifdef NP_DEBUG
             printf ("SERVER: Client %d Paused: %s @%ld\n", c, (header [2] & 0x80) ? "YES" : "NO", S9xGetMilliTime () - START);
@@ -619,6 +648,7 @@ static bool8 S9xNPServerInit (int port)
         NPServer.Clients [i].HostName = NULL;
         NPServer.Clients [i].Who = NULL;
         NPServer.Joypads [i] = 0;
+        memset (NPServer.ChecksumFrames [i], 0xff, sizeof (NPServer.ChecksumFrames [i]));
     }
 
     NPServer.NumClients = 0;
@@ -170,7 +170,7 @@ struct SnapshotScreenshotInfo
 	uint8	Data[MAX_SNES_WIDTH * MAX_SNES_HEIGHT * 3];
 };
 
-static struct Obsolete
+static S9X_INSTANCE struct Obsolete
 {
 	uint8	CPU_IRQActive;
 }	Obsolete;
@@ -988,7 +988,7 @@ static void SkipBlockWithName(STREAM stream, const char *name);
 
 void S9xResetSaveTimer (bool8 dontsave)
 {
-	static time_t	t = -1;
+	static S9X_INSTANCE time_t	t = -1;
 
 	if (!Settings.DontSaveOopsSnapshot && !dontsave && t != -1 && time(NULL) - t > 300)
 	{
@@ -1021,13 +1021,33 @@ bool8 S9xFreezeGameMem (uint8 *buf, uint32 bufSize)
 
 bool8 S9xFreezeGame (const char *filename)
 {
+	// Serialize into one buffer and hand it to the compressor in a single
+	// write instead of one small write per block. The buffer is kept for
+	// the next save.
+	static S9X_INSTANCE uint8	*freeze_buf = NULL;
+	static S9X_INSTANCE uint32	freeze_buf_size = 0;
+
 	STREAM	stream = NULL;
+	uint32	size = S9xFreezeSize();
+
+	if (size > freeze_buf_size)
+	{
+		delete [] freeze_buf;
+		freeze_buf = new uint8[size];
+		freeze_buf_size = size;
+	}
+
+	S9xFreezeGameMem(freeze_buf, size);
 
 	if (S9xOpenSnapshotFile(filename, FALSE, &stream))
 	{
-		S9xFreezeToStream(stream);
+		LEVEL_STREAM(stream, Settings.SnapshotCompression);
+		bool8	ok = WRITE_STREAM(freeze_buf, size, stream) == size;
 		S9xCloseSnapshotFile(stream);
 
+		if (!ok)
+			return (FALSE);
+
 		S9xResetSaveTimer(TRUE);
 
 		const char *base = S9xBasename(filename);
@@ -1613,6 +1633,7 @@ int S9xUnfreezeFromStream (STREAM stream)
 		CPU.Flags |= old_flags & (DEBUG_MODE_FLAG | TRACE_FLAG | SINGLE_STEP_FLAG | FRAME_ADVANCE_FLAG);
 		ICPU.ShiftedPB = Registers.PB << 16;
 		ICPU.ShiftedDB = Registers.DB << 16;
+		Memory.UpdateSpeedMap();
 		S9xSetPCBase(Registers.PBPC);
 		S9xUnpackStatus();
 		if(version < SNAPSHOT_VERSION_IRQ_2018)
@@ -1626,6 +1647,7 @@ int S9xUnfreezeFromStream (STREAM stream)
 		CPU.InDMAorHDMA = CPU.InWRAMDMAorHDMA = FALSE;
 		CPU.HDMARanInDMA = 0;
 
+		S9xResetPaletteCache();
 		S9xFixColourBrightness();
 		S9xBuildDirectColourMaps();
 		IPPU.ColorsChanged = TRUE;
@@ -1673,7 +1695,7 @@ int S9xUnfreezeFromStream (STREAM stream)
 		if (local_movie_data)
 		{
 			// restore last displayed pad_read status
-			extern bool8	pad_read, pad_read_last;
+			extern S9X_INSTANCE bool8	pad_read, pad_read_last;
 			bool8			pad_read_temp = pad_read;
 
 			pad_read = pad_read_last;
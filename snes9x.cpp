@@ -17,6 +17,7 @@
 #include "cheats.h"
 #include "display.h"
 #include "conffile.h"
+#include "statehash.h"
 #ifdef NETPLAY_SUPPORT
 #include "netplay.h"
 #endif
@@ -264,7 +265,15 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.MovieTruncate              =  conf.GetBool("Settings::MovieTruncateAtEnd",        false);
 	Settings.MovieNotifyIgnored         =  conf.GetBool("Settings::MovieNotifyIgnored",        false);
 	Settings.WrongMovieStateProtection  =  conf.GetBool("Settings::WrongMovieStateProtection", true);
+	Settings.MovieKeyframeInterval      =  conf.GetInt ("Settings::MovieKeyframeInterval",     0);
 	Settings.StretchScreenshots         =  conf.GetInt ("Settings::StretchScreenshots",        1);
+	Settings.ScreenshotCompression      =  conf.GetInt ("Settings::ScreenshotCompression",     6);
+	// zlib levels, -1 picks its default
+	if (Settings.ScreenshotCompression < -1)
+		Settings.ScreenshotCompression = -1;
+	if (Settings.ScreenshotCompression > 9)
+		Settings.ScreenshotCompression = 9;
+	Settings.SnapshotCompression        =  conf.GetInt ("Settings::SnapshotCompression",       1);
 	Settings.SnapshotScreenshots        =  conf.GetBool("Settings::SnapshotScreenshots",       true);
 	Settings.DontSaveOopsSnapshot       =  conf.GetBool("Settings::DontSaveOopsSnapshot",      false);
 	Settings.AutoSaveDelay              =  conf.GetUInt("Settings::AutoSaveDelay",             0);
@@ -306,6 +315,7 @@ void S9xLoadConfigFiles (char **argv, int argc)
 
 	// Hack
 	Settings.SuperFXClockMultiplier         = conf.GetUInt("Hack::SuperFXClockMultiplier", 100);
+	Settings.SA1SyncQuantum                 = conf.GetInt ("Hack::SA1SyncQuantum",         0);
     Settings.OverclockMode                  = conf.GetUInt("Hack::OverclockMode", 0);
     Settings.SeparateEchoBuffer             = conf.GetBool("Hack::SeparateEchoBuffer", false);
 	Settings.DisableGameSpecificHacks       = !conf.GetBool("Hack::EnableGameSpecificHacks",       true);
@@ -325,6 +335,10 @@ void S9xLoadConfigFiles (char **argv, int argc)
 	Settings.ServerName[0] = '\0';
 	if (conf.Exists("Netplay::Server"))
 		conf.GetString("Netplay::Server", Settings.ServerName, 128);
+
+	Settings.NetPlayRollback = conf.GetBool("Netplay::Rollback", false);
+	Settings.NetPlayLoopbackFrames = 0;
+	Settings.NetPlayLoopbackLatency = 4;
 #endif
 
 	// Debug
@@ -422,6 +436,11 @@ void S9xUsage (void)
 	S9xMessage(S9X_INFO, S9X_USAGE, "-port <num>                     Use port <num> for netplay (use with -net)");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-server <string>                Use the specified server for netplay");
 	S9xMessage(S9X_INFO, S9X_USAGE, "                                (use with -net)");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-netrollback                    Run ahead of the server and roll back on");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                late input (use with -net)");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-netloopback <num>              Check rollback against lockstep for <num>");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                frames without a server, then exit");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-netlatency <num>               Input delay in frames for -netloopback");
 	S9xMessage(S9X_INFO, S9X_USAGE, "");
 #endif
 
@@ -433,6 +452,10 @@ void S9xUsage (void)
 	S9xMessage(S9X_INFO, S9X_USAGE, "-hdmatiming <1-199>             (Not recommended) Changes HDMA transfer timings");
 	S9xMessage(S9X_INFO, S9X_USAGE, "                                event comes");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-invalidvramaccess              (Not recommended) Allow invalid VRAM access");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-hashrecord <filename>          Write per-frame hashes of memory and screen");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-hashverify <filename>          Stop at the first frame that differs from the");
+	S9xMessage(S9X_INFO, S9X_USAGE, "                                hashes in <filename>");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-hashframes <num>               Stop hashing after <num> frames");
 	S9xMessage(S9X_INFO, S9X_USAGE, "");
 
 	// OTHER OPTIONS
@@ -680,6 +703,25 @@ char * S9xParseArgs (char **argv, int argc)
 					S9xUsage();
 			}
 			else
+			if (!strcasecmp(argv[i], "-netrollback"))
+				Settings.NetPlayRollback = TRUE;
+			else
+			if (!strcasecmp(argv[i], "-netloopback"))
+			{
+				if (i + 1 < argc)
+					Settings.NetPlayLoopbackFrames = atoi(argv[++i]);
+				else
+					S9xUsage();
+			}
+			else
+			if (!strcasecmp(argv[i], "-netlatency"))
+			{
+				if (i + 1 < argc)
+					Settings.NetPlayLoopbackLatency = atoi(argv[++i]);
+				else
+					S9xUsage();
+			}
+			else
 		#endif
 
 			// HACKING OR DEBUGGING OPTIONS
@@ -711,6 +753,27 @@ char * S9xParseArgs (char **argv, int argc)
 			if (!strcasecmp(argv[i], "-invalidvramaccess"))
 				Settings.BlockInvalidVRAMAccessMaster = FALSE;
 			else
+			if (!strcasecmp(argv[i], "-hashrecord") || !strcasecmp(argv[i], "-hashverify"))
+			{
+				if (i + 1 < argc)
+				{
+					Settings.StateHashMode = !strcasecmp(argv[i], "-hashrecord") ? STATEHASH_RECORD : STATEHASH_VERIFY;
+					strncpy(Settings.StateHashFile, argv[++i], PATH_MAX);
+					Settings.StateHashFile[PATH_MAX] = 0;
+					Settings.Headless = TRUE;
+				}
+				else
+					S9xUsage();
+			}
+			else
+			if (!strcasecmp(argv[i], "-hashframes"))
+			{
+				if (i + 1 < argc)
+					Settings.StateHashMaxFrames = atoi(argv[++i]);
+				else
+					S9xUsage();
+			}
+			else
 
 			// OTHER OPTIONS
 
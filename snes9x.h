@@ -27,6 +27,7 @@
 #define FIND_FSTREAM(f)			gztell(f)
 #define REVERT_FSTREAM(s, o, p)	gzseek(s, o, p)
 #define CLOSE_FSTREAM(s)			gzclose(s)
+#define LEVEL_FSTREAM(s, l)		gzsetparams(s, l, Z_DEFAULT_STRATEGY)
 #else
 #define FSTREAM					FILE *
 #define READ_FSTREAM(p, l, s)	fread(p, 1, l, s)
@@ -38,6 +39,7 @@
 #define FIND_FSTREAM(s)			ftell(s)
 #define REVERT_FSTREAM(s, o, p)	fseek(s, o, p)
 #define CLOSE_FSTREAM(s)			fclose(s)
+#define LEVEL_FSTREAM(s, l)
 #endif
 
 #include "stream.h"
@@ -52,6 +54,7 @@
 #define FIND_STREAM(s)			s->pos()
 #define REVERT_STREAM(s, o, p)	s->revert(p, o)
 #define CLOSE_STREAM(s)			s->closeStream()
+#define LEVEL_STREAM(s, l)		s->set_compression(l)
 
 #define SNES_WIDTH					256
 #define SNES_HEIGHT					224
@@ -278,18 +281,28 @@ struct SSettings
 	bool8	NetPlayServer;
 	char	ServerName[128];
 	int		Port;
+	bool8	NetPlayRollback;
+	uint32	NetPlayLoopbackFrames;
+	uint32	NetPlayLoopbackLatency;
 
 	bool8	MovieTruncate;
 	bool8	MovieNotifyIgnored;
 	bool8	WrongMovieStateProtection;
+	int32	MovieKeyframeInterval;
 	bool8	DumpStreams;
 	int		DumpStreamsMaxFrames;
+	uint8	StateHashMode;
+	char	StateHashFile[PATH_MAX + 1];
+	int		StateHashMaxFrames;
 
 	bool8	TakeScreenshot;
+	bool8	Headless;
 	int8	StretchScreenshots;
+	int8	ScreenshotCompression;
 	bool8	SnapshotScreenshots;
 	char    InitialSnapshotFilename[PATH_MAX + 1];
 	bool8	FastSavestates;
+	int8	SnapshotCompression;
 
 	bool8	ApplyCheats;
 	bool8	NoPatch;
@@ -303,6 +316,7 @@ struct SSettings
 
     bool8   SeparateEchoBuffer;
 	uint32	SuperFXClockMultiplier;
+	int32	SA1SyncQuantum;
     int OverclockMode;
 	int	OneClockCycle;
 	int	OneSlowClockCycle;
@@ -333,10 +347,10 @@ void S9xClearPause(uint32);
 void S9xExit(void);
 void S9xMessage(int, int, const char *);
 
-extern struct SSettings			Settings;
-extern struct SCPUState			CPU;
-extern struct STimings			Timings;
-extern struct SSNESGameFixes	SNESGameFixes;
-extern char						String[513];
+extern S9X_INSTANCE struct SSettings			Settings;
+extern S9X_INSTANCE struct SCPUState			CPU;
+extern S9X_INSTANCE struct STimings			Timings;
+extern S9X_INSTANCE struct SSNESGameFixes	SNESGameFixes;
+extern S9X_INSTANCE char						String[513];
 
 #endif
@@ -39,7 +39,7 @@
 #include "spc7110emu.h"
 #include "spc7110emu.cpp"
 
-SPC7110	s7emu;
+S9X_INSTANCE SPC7110	s7emu;
 
 static void SetSPC7110SRAMMap (uint8);
 
@@ -74,8 +74,8 @@ void SPC7110Decomp::init(unsigned mode, unsigned offset, unsigned index) {
 //
 
 void SPC7110Decomp::mode0(bool init) {
-  static uint8 val, in, span;
-  static int out, inverts, lps, in_count;
+  static S9X_INSTANCE uint8 val, in, span;
+  static S9X_INSTANCE int out, inverts, lps, in_count;
 
   if(init == true) {
     out = inverts = lps = 0;
@@ -141,9 +141,9 @@ void SPC7110Decomp::mode0(bool init) {
 }
 
 void SPC7110Decomp::mode1(bool init) {
-  static unsigned pixelorder[4], realorder[4];
-  static uint8 in, val, span;
-  static int out, inverts, lps, in_count;
+  static S9X_INSTANCE unsigned pixelorder[4], realorder[4];
+  static S9X_INSTANCE uint8 in, val, span;
+  static S9X_INSTANCE int out, inverts, lps, in_count;
 
   if(init == true) {
     for(unsigned i = 0; i < 4; i++) pixelorder[i] = i;
@@ -244,10 +244,10 @@ void SPC7110Decomp::mode1(bool init) {
 }
 
 void SPC7110Decomp::mode2(bool init) {
-  static unsigned pixelorder[16], realorder[16];
-  static uint8 bitplanebuffer[16], buffer_index;
-  static uint8 in, val, span;
-  static int out0, out1, inverts, lps, in_count;
+  static S9X_INSTANCE unsigned pixelorder[16], realorder[16];
+  static S9X_INSTANCE uint8 bitplanebuffer[16], buffer_index;
+  static S9X_INSTANCE uint8 in, val, span;
+  static S9X_INSTANCE int out0, out1, inverts, lps, in_count;
 
   if(init == true) {
     for(unsigned i = 0; i < 16; i++) pixelorder[i] = i;
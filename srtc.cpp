@@ -34,7 +34,7 @@ static inline unsigned min (unsigned a, unsigned b)
 #include "srtcemu.h"
 #include "srtcemu.cpp"
 
-static SRTC	srtcemu;
+static S9X_INSTANCE SRTC	srtcemu;
 
 
 void S9xInitSRTC (void)
@@ -0,0 +1,227 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+// Per-frame state hashing for regression runs.
+// After every frame WRAM, VRAM, CGRAM, OAM and the rendered picture are
+// hashed. In record mode one line per frame is written to
+// Settings.StateHashFile:
+//
+//   frame wram vram cgram oam screen
+//
+// as hexadecimal, with "--------" for a screen that was not rendered. In
+// verify mode the same file is read back and the run stops at the first
+// frame that differs, naming the parts that differ. Either way the frame
+// time distribution is printed at the end, so a played movie gives both a
+// correctness and a speed check. Hashing runs headless: every frame is
+// rendered and the frontend never syncs or presents. A divergence or a
+// malformed file makes the process exit non-zero. Runs are independent
+// processes and can be spread over cores by the caller.
+
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "snes9x.h"
+#include "memmap.h"
+#include "ppu.h"
+#include "movie.h"
+#include "display.h"
+#include "statehash.h"
+
+#define STATEHASH_PARTS	5
+
+static const char	*part_names[STATEHASH_PARTS - 1] = { "WRAM", "VRAM", "CGRAM", "OAM" };
+
+static S9X_INSTANCE FILE		*hashfile = NULL;
+static S9X_INSTANCE uint32	framecounter = 0, frames_done = 0;
+static S9X_INSTANCE uint32	screen_hash;
+static S9X_INSTANCE bool		screen_valid = false, movie_seen = false, diverged = false, failed = false;
+static S9X_INSTANCE char		diverged_parts[64];
+static S9X_INSTANCE uint32	diverged_frame;
+
+static S9X_INSTANCE std::chrono::steady_clock::time_point	last_frame;
+static S9X_INSTANCE std::vector<uint32>						frame_times;
+
+static uint32 HashBytes (uint32 h, const uint8 *p, uint32 len)
+{
+	for (uint32 i = 0; i < len; i++)
+		h = (h ^ p[i]) * 16777619u;
+
+	return (h);
+}
+
+void S9xResetStateHash (void)
+{
+	static bool	registered = false;
+
+	if (Settings.StateHashMode == STATEHASH_OFF)
+		return;
+
+	S9xCloseStateHash();
+
+	hashfile = fopen(Settings.StateHashFile, Settings.StateHashMode == STATEHASH_RECORD ? "w" : "r");
+	if (!hashfile)
+	{
+		fprintf(stderr, "statehash: can't open %s.\n", Settings.StateHashFile);
+		exit(1);
+	}
+
+	if (!registered)
+	{
+		atexit(S9xCloseStateHash);
+		registered = true;
+	}
+
+	framecounter = frames_done = 0;
+	screen_valid = movie_seen = diverged = failed = false;
+	frame_times.clear();
+	last_frame = std::chrono::steady_clock::now();
+}
+
+void S9xCloseStateHash (void)
+{
+	if (!hashfile)
+		return;
+
+	fclose(hashfile);
+	hashfile = NULL;
+
+	if (Settings.StateHashMode == STATEHASH_VERIFY)
+	{
+		if (diverged)
+			printf("statehash: FAIL at frame %u: %s\n", diverged_frame, diverged_parts);
+		else
+			printf("statehash: PASS, %u frames\n", frames_done);
+	}
+	else
+		printf("statehash: recorded %u frames\n", frames_done);
+
+	if (frame_times.empty())
+		return;
+
+	std::vector<uint32>	t(frame_times);
+	uint64				sum = 0;
+
+	std::sort(t.begin(), t.end());
+	for (size_t i = 0; i < t.size(); i++)
+		sum += t[i];
+
+	printf("statehash: frame time (us) min %u p50 %u p90 %u p99 %u max %u mean %u\n",
+		t[0], t[t.size() / 2], t[t.size() * 9 / 10], t[t.size() * 99 / 100], t.back(), (uint32) (sum / t.size()));
+}
+
+bool8 S9xStateHashFailed (void)
+{
+	return (failed);
+}
+
+void S9xStateHashScreen (int width, int height)
+{
+	uint32	h = 2166136261u;
+
+	if (!hashfile)
+		return;
+
+	for (int y = 0; y < height; y++)
+		h = HashBytes(h, (uint8 *) (GFX.Screen + y * GFX.RealPPL), width * sizeof(uint16));
+
+	screen_hash = h;
+	screen_valid = true;
+}
+
+static bool Finished (void)
+{
+	if (Settings.StateHashMaxFrames > 0 && frames_done >= (uint32) Settings.StateHashMaxFrames)
+		return (true);
+
+	// a movie that has played to its end leaves nothing more to check
+	if (S9xMovieActive())
+		movie_seen = true;
+	else
+	if (movie_seen)
+		return (true);
+
+	return (false);
+}
+
+void S9xStateHashFrame (void)
+{
+	if (!hashfile)
+		return;
+
+	std::chrono::steady_clock::time_point	now = std::chrono::steady_clock::now();
+	frame_times.push_back((uint32) std::chrono::duration_cast<std::chrono::microseconds>(now - last_frame).count());
+	last_frame = now;
+
+	framecounter = S9xMovieActive() ? S9xMovieGetFrameCounter() : framecounter + 1;
+
+	uint32	h[STATEHASH_PARTS];
+	h[0] = HashBytes(2166136261u, Memory.RAM, 0x20000);
+	h[1] = HashBytes(2166136261u, Memory.VRAM, 0x10000);
+	h[2] = HashBytes(2166136261u, (uint8 *) PPU.CGDATA, sizeof(PPU.CGDATA));
+	h[3] = HashBytes(2166136261u, PPU.OAMData, sizeof(PPU.OAMData));
+	h[4] = screen_hash;
+
+	char	screen[9];
+	if (screen_valid)
+		sprintf(screen, "%08x", h[4]);
+	else
+		strcpy(screen, "--------");
+	screen_valid = false;
+
+	if (Settings.StateHashMode == STATEHASH_RECORD)
+		fprintf(hashfile, "%u %08x %08x %08x %08x %s\n", framecounter, h[0], h[1], h[2], h[3], screen);
+	else
+	{
+		char	line[128], gscreen[16];
+		uint32	gframe, g[STATEHASH_PARTS];
+
+		if (!fgets(line, sizeof(line), hashfile))
+		{
+			S9xCloseStateHash();
+			S9xExit();
+			return;
+		}
+
+		if (sscanf(line, "%u %x %x %x %x %15s", &gframe, &g[0], &g[1], &g[2], &g[3], gscreen) != 6)
+		{
+			fprintf(stderr, "statehash: malformed line in %s.\n", Settings.StateHashFile);
+			failed = true;
+			S9xCloseStateHash();
+			S9xExit();
+			return;
+		}
+
+		diverged_parts[0] = 0;
+		if (gframe != framecounter)
+			strcat(diverged_parts, " frame-number");
+		for (int i = 0; i < STATEHASH_PARTS - 1; i++)
+			if (g[i] != h[i])
+			{
+				strcat(diverged_parts, " ");
+				strcat(diverged_parts, part_names[i]);
+			}
+		// a screen only counts when both runs rendered it
+		if (strcmp(screen, "--------") && strcmp(gscreen, "--------") && strcmp(gscreen, screen))
+			strcat(diverged_parts, " screen");
+
+		if (diverged_parts[0])
+		{
+			diverged = failed = true;
+			diverged_frame = framecounter;
+			memmove(diverged_parts, diverged_parts + 1, strlen(diverged_parts));
+		}
+	}
+
+	frames_done++;
+
+	if (diverged || Finished())
+	{
+		S9xCloseStateHash();
+		S9xExit();
+	}
+}
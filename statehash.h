@@ -0,0 +1,26 @@
+/*****************************************************************************\
+     Snes9x - Portable Super Nintendo Entertainment System (TM) emulator.
+                This file is licensed under the Snes9x License.
+   For further information, consult the LICENSE file in the root directory.
+\*****************************************************************************/
+
+#ifndef _STATEHASH_H_
+#define _STATEHASH_H_
+
+enum
+{
+	STATEHASH_OFF,
+	STATEHASH_RECORD,
+	STATEHASH_VERIFY
+};
+
+void S9xResetStateHash (void);
+void S9xCloseStateHash (void);
+// True after a divergence or a malformed file; frontends exit non-zero.
+bool8 S9xStateHashFailed (void);
+// Hash the rendered frame, before any messages are drawn over it.
+void S9xStateHashScreen (int, int);
+// Hash memory and log or check the frame just finished.
+void S9xStateHashFrame (void);
+
+#endif
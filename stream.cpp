@@ -117,6 +117,11 @@ size_t fStream::write (void *buf, size_t len)
     return (WRITE_FSTREAM(buf, len, fp));
 }
 
+void fStream::set_compression (int level)
+{
+    LEVEL_FSTREAM(fp, level);
+}
+
 size_t fStream::pos (void)
 {
     return (FIND_FSTREAM(fp));
@@ -24,6 +24,8 @@ class Stream
         virtual size_t size (void) = 0;
         virtual int revert (uint8 origin, int32 offset) = 0;
         virtual void closeStream() = 0;
+        // only meaningful for compressed file streams, call before writing
+        virtual void set_compression (int) { }
 
 	protected:
 		size_t pos_from_origin_offset(uint8 origin, int32 offset);
@@ -42,6 +44,7 @@ class fStream : public Stream
         virtual size_t size (void);
         virtual int revert (uint8 origin, int32 offset);
         virtual void closeStream();
+        virtual void set_compression (int);
 
 	private:
 		FSTREAM	fp;
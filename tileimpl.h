@@ -11,7 +11,7 @@
 #include "ppu.h"
 #include "tile.h"
 
-extern struct SLineMatrixData	LineMatrixData[240];
+extern S9X_INSTANCE struct SLineMatrixData	LineMatrixData[240];
 
 
 namespace TileImpl {
@@ -593,14 +593,38 @@ namespace TileImpl {
 
 				uint8	Pix;
 
-				if (!PPU.Mode7Repeat)
+				// Step the transformed position directly instead of re-adding BB/DD per pixel
+				int	XPos = AA + BB;
+				int	YPos = CC + DD;
+
+				// The position moves linearly along the line, so if both ends land inside
+				// the 1024x1024 field every pixel does and the wrap-around path applies.
+				bool	inside = !PPU.Mode7Repeat;
+				if (!inside)
+				{
+					int	n  = Right - Left - 1;
+					int	X0 = XPos >> 8, X1 = (XPos + aa * n) >> 8;
+					int	Y0 = YPos >> 8, Y1 = (YPos + cc * n) >> 8;
+					inside = ((X0 | X1 | Y0 | Y1) & ~0x3ff) == 0;
+				}
+
+				if (inside)
 				{
-					for (uint32 x = Left; x < Right; x++, AA += aa, CC += cc)
+					// neighbouring pixels mostly share a tile, so keep its character pointer
+					uint32	LastTile = ~0u;
+					uint8	*TileData = VRAM1;
+
+					for (uint32 x = Left; x < Right; x++, XPos += aa, YPos += cc)
 					{
-						int	X = ((AA + BB) >> 8) & 0x3ff;
-						int	Y = ((CC + DD) >> 8) & 0x3ff;
+						int	X = (XPos >> 8) & 0x3ff;
+						int	Y = (YPos >> 8) & 0x3ff;
 
-						uint8	*TileData = VRAM1 + (Memory.VRAM[((Y & ~7) << 5) + ((X >> 2) & ~1)] << 7);
+						uint32	Tile = ((Y & ~7) << 5) + ((X >> 2) & ~1);
+						if (Tile != LastTile)
+						{
+							LastTile = Tile;
+							TileData = VRAM1 + (Memory.VRAM[Tile] << 7);
+						}
 						uint8	b = *(TileData + ((Y & 7) << 4) + ((X & 7) << 1));
 
 						Pix = b & OP::MASK; DRAW_PIXEL(x, Pix);
@@ -608,10 +632,12 @@ namespace TileImpl {
 				}
 				else
 				{
-					for (uint32 x = Left; x < Right; x++, AA += aa, CC += cc)
+					bool	fill = PPU.Mode7Repeat == 3;
+
+					for (uint32 x = Left; x < Right; x++, XPos += aa, YPos += cc)
 					{
-						int	X = ((AA + BB) >> 8);
-						int	Y = ((CC + DD) >> 8);
+						int	X = (XPos >> 8);
+						int	Y = (YPos >> 8);
 
 						uint8	b;
 
@@ -621,7 +647,7 @@ namespace TileImpl {
 							b = *(TileData + ((Y & 7) << 4) + ((X & 7) << 1));
 						}
 						else
-						if (PPU.Mode7Repeat == 3)
+						if (fill)
 							b = *(VRAM1    + ((Y & 7) << 4) + ((X & 7) << 1));
 						else
 							continue;
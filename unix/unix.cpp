@@ -44,6 +44,7 @@
 #include "logger.h"
 #include "display.h"
 #include "conffile.h"
+#include "statehash.h"
 #ifdef NETPLAY_SUPPORT
 #include "netplay.h"
 #endif
@@ -80,6 +81,7 @@ static const char	*s9x_base_dir        = NULL,
 					*snapshot_filename   = NULL,
 					*play_smv_filename   = NULL,
 					*record_smv_filename = NULL;
+static uint32		seek_smv_frame       = 0;
 
 static char		default_dir[PATH_MAX + 1];
 
@@ -269,6 +271,7 @@ void S9xExtraUsage (void)
 
 	S9xMessage(S9X_INFO, S9X_USAGE, "-loadsnapshot                   Load snapshot file at start");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-playmovie <filename>           Start emulator playing the .smv file");
+	S9xMessage(S9X_INFO, S9X_USAGE, "-seekmovie <frame>              Seek the played movie to <frame> at start");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-recordmovie <filename>         Start emulator recording the .smv file");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-dumpstreams                    Save audio/video data to disk");
 	S9xMessage(S9X_INFO, S9X_USAGE, "-dumpmaxframes <num>            Stop emulator after saving specified number of");
@@ -364,6 +367,14 @@ void S9xParseArg (char **argv, int &i, int argc)
 			S9xUsage();
 	}
 	else
+	if (!strcasecmp(argv[i], "-seekmovie"))
+	{
+		if (i + 1 < argc)
+			seek_smv_frame = atoi(argv[++i]);
+		else
+			S9xUsage();
+	}
+	else
 	if (!strcasecmp(argv[i], "-recordmovie"))
 	{
 		if (i + 1 < argc)
@@ -723,10 +734,25 @@ bool8 S9xInitUpdate (void)
 
 bool8 S9xDeinitUpdate (int width, int height)
 {
-	S9xPutImage(width, height);
+	if (!Settings.Headless)
+		S9xPutImage(width, height);
 	return (TRUE);
 }
 
+// Headless runs have no window; render into a plain buffer instead.
+static void S9xInitHeadlessScreen (void)
+{
+	GFX.Pitch = SNES_WIDTH * 2 * 2;
+	GFX.Screen = (uint16 *) calloc(GFX.Pitch * SNES_HEIGHT_EXTENDED * 2, 1);
+	if (!GFX.Screen)
+	{
+		fprintf(stderr, "Failed to allocate the screen buffer.\n");
+		exit(1);
+	}
+
+	S9xGraphicsInit();
+}
+
 bool8 S9xContinueUpdate (int width, int height)
 {
 	return (TRUE);
@@ -746,7 +772,7 @@ void S9xToggleSoundChannel (int c)
 
 void S9xAutoSaveSRAM (void)
 {
-	Memory.SaveSRAM(S9xGetFilename(".srm", SRAM_DIR));
+	Memory.AutoSaveSRAM(S9xGetFilename(".srm", SRAM_DIR));
 }
 
 void S9xSyncSpeed (void)
@@ -762,7 +788,8 @@ void S9xSyncSpeed (void)
 		return;
 
 #ifdef NETPLAY_SUPPORT
-	if (Settings.NetPlay && NetPlay.Connected)
+	// rollback clients keep their own pace and never wait for the server here
+	if (Settings.NetPlay && NetPlay.Connected && !NetPlay.Rollback.Enabled)
 	{
 	#if defined(NP_DEBUG) && NP_DEBUG == 2
 		printf("CLIENT: SyncSpeed @%d\n", S9xGetMilliTime());
@@ -1415,11 +1442,12 @@ void S9xExit (void)
 	S9xResetSaveTimer(FALSE);
 	S9xSaveCheatFile(S9xGetFilename(".cht", CHEAT_DIR));
 	S9xUnmapAllControls();
-	S9xDeinitDisplay();
+	if (!Settings.Headless)
+		S9xDeinitDisplay();
 	Memory.Deinit();
 	S9xDeinitAPU();
 
-	exit(0);
+	exit(S9xStateHashFailed() ? 1 : 0);
 }
 
 #ifdef DEBUGGER
@@ -1461,6 +1489,8 @@ int main (int argc, char **argv)
 	Settings.WrongMovieStateProtection = TRUE;
 	Settings.DumpStreamsMaxFrames = -1;
 	Settings.StretchScreenshots = 1;
+	Settings.ScreenshotCompression = 6;
+	Settings.SnapshotCompression = 1;
 	Settings.SnapshotScreenshots = TRUE;
 	Settings.SkipFrames = AUTO_FRAMERATE;
 	Settings.TurboSkipFrames = 15;
@@ -1589,6 +1619,16 @@ int main (int argc, char **argv)
 	CPU.Flags = saved_flags;
 	Settings.StopEmulation = FALSE;
 
+#ifdef NETPLAY_SUPPORT
+	if (Settings.NetPlayLoopbackFrames)
+	{
+		bool8	ok = S9xNPRollbackLoopbackTest(Settings.NetPlayLoopbackFrames, Settings.NetPlayLoopbackLatency);
+
+		printf("%s\n%s\n", NetPlay.ActionMsg, ok ? "PASS" : "FAIL");
+		exit(ok ? 0 : 1);
+	}
+#endif
+
 #ifdef DEBUGGER
 	struct sigaction sa;
 	sa.sa_handler = sigbrkhandler;
@@ -1602,9 +1642,14 @@ int main (int argc, char **argv)
 #endif
 
 	S9xInitInputDevices();
-	S9xInitDisplay(argc, argv);
-	S9xSetupDefaultKeymap();
-	S9xTextMode();
+	if (Settings.Headless)
+		S9xInitHeadlessScreen();
+	else
+	{
+		S9xInitDisplay(argc, argv);
+		S9xSetupDefaultKeymap();
+		S9xTextMode();
+	}
 
 #ifdef NETPLAY_SUPPORT
 	if (strlen(Settings.ServerName) == 0)
@@ -1637,6 +1682,10 @@ int main (int argc, char **argv)
 		}
 
 		fprintf(stderr, "Connected to server %s on port %d as player #%d playing %s.\n", Settings.ServerName, Settings.Port, NetPlay.Player, Memory.ROMName);
+
+		// the server's first heart-beat is numbered FrameCount + 1
+		if (Settings.NetPlayRollback)
+			S9xNPRollbackInit(NetPlay.FrameCount + 1);
 	}
 #endif
 
@@ -1645,6 +1694,8 @@ int main (int argc, char **argv)
 		uint32	flags = CPU.Flags & (DEBUG_MODE_FLAG | TRACE_FLAG);
 		if (S9xMovieOpen(play_smv_filename, TRUE) != SUCCESS)
 			exit(1);
+		if (seek_smv_frame && S9xMovieSeek(seek_smv_frame) != SUCCESS)
+			exit(1);
 		CPU.Flags |= flags;
 	}
 	else
@@ -1670,10 +1721,13 @@ int main (int argc, char **argv)
 		}
 	}
 
-	S9xGraphicsMode();
+	if (!Settings.Headless)
+	{
+		S9xGraphicsMode();
 
-	sprintf(String, "\"%s\" %s: %s", Memory.ROMName, TITLE, VERSION);
-	S9xSetTitle(String);
+		sprintf(String, "\"%s\" %s: %s", Memory.ROMName, TITLE, VERSION);
+		S9xSetTitle(String);
+	}
 
 #ifdef JOYSTICK_SUPPORT
 	uint32	JoypadSkip = 0;
@@ -1688,6 +1742,34 @@ int main (int argc, char **argv)
 	while (1)
 	{
 	#ifdef NETPLAY_SUPPORT
+		bool8	NP_RollbackFrame = FALSE;
+
+		if (NP_Activated && NetPlay.Rollback.Enabled)
+		{
+			if (!NetPlay.Connected)
+			{
+				fprintf(stderr, "Lost connection to server.\n");
+				S9xExit();
+			}
+
+			for (int J = 0; J < 8; J++)
+				old_joypads[J] = MovieGetJoypad(J);
+
+			if (!Settings.Paused)
+			{
+				// too far ahead of the server to predict, give its input time to arrive
+				if (!S9xNPRollbackBeginFrame(old_joypads[0]))
+				{
+					S9xNPCheckForHeartBeat(10);
+					S9xProcessEvents(FALSE);
+					continue;
+				}
+
+				S9xNPSendJoypadUpdate(old_joypads[0]);
+				NP_RollbackFrame = TRUE;
+			}
+		}
+		else
 		if (NP_Activated)
 		{
 			if (NetPlay.PendingWait4Sync && !S9xNPWaitForHeartBeatDelay(100))
@@ -1748,6 +1830,9 @@ int main (int argc, char **argv)
                 }
 
 	#ifdef NETPLAY_SUPPORT
+		if (NP_RollbackFrame)
+			S9xNPRollbackEndFrame();
+
 		if (NP_Activated)
 		{
 			for (int J = 0; J < 8; J++)
@@ -1782,7 +1867,8 @@ int main (int argc, char **argv)
 		}
 	#endif
 
-		S9xProcessEvents(FALSE);
+		if (!Settings.Headless)
+			S9xProcessEvents(FALSE);
 
 	#ifdef DEBUGGER
 		if (!Settings.Paused && !(CPU.Flags & DEBUG_MODE_FLAG))
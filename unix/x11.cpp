@@ -364,6 +364,7 @@ const char * S9xParseDisplayConfig (ConfigFile &conf, int pass)
 		keymaps.push_back(strpair_t("K00:S+minus",      "DecFrameTime"));
 		keymaps.push_back(strpair_t("K00:6",            "SwapJoypads"));
 		keymaps.push_back(strpair_t("K00:Print",        "Screenshot"));
+		keymaps.push_back(strpair_t("K00:S+Print",      "ScreenshotBurst"));
 
 		keymaps.push_back(strpair_t("K00:1",            "ToggleBG0"));
 		keymaps.push_back(strpair_t("K00:2",            "ToggleBG1"));
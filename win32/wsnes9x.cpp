@@ -150,7 +150,7 @@ void ClearExts(void);
 static bool ExtensionIsValid(const TCHAR *filename);
 
 extern FILE *trace_fs;
-extern SCheatData Cheat;
+extern S9X_INSTANCE SCheatData Cheat;
 extern bool8 do_frame_adjust;
 
 TCHAR multiRomA[MAX_PATH] = { 0 }; // lazy, should put in sGUI and add init to {0} somewhere
@@ -2217,7 +2217,7 @@ LRESULT CALLBACK WinProc(
 			}else{
 				S9xCheatsEnable ();
 				bool on = false;
-				extern struct SCheatData Cheat;
+				extern S9X_INSTANCE struct SCheatData Cheat;
 				for (uint32 i = 0; i < Cheat.g.size() && !on; i++)
 					if (Cheat.g [i].enabled)
 						on = true;
@@ -5189,6 +5189,9 @@ INT_PTR CALLBACK DlgEmulatorHacksProc(HWND hDlg, UINT msg, WPARAM wParam, LPARAM
                 break;
             }
 
+            // the access speed table caches the cycle counts
+            Memory.UpdateSpeedMap();
+
             EndDialog(hDlg, must_reset);
             return true;
 
@@ -10960,7 +10963,7 @@ void S9xPostRomInit()
 	if (Settings.ApplyCheats)
 	{
 		S9xCheatsEnable();
-		extern struct SCheatData Cheat;
+		extern S9X_INSTANCE struct SCheatData Cheat;
 	    for (uint32 i = 0; i < Cheat.g.size(); i++)
 		{
 	        if (Cheat.g [i].enabled)